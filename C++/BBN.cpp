@@ -6,11 +6,41 @@
 //     "The Early Universe" chapter 4
 
 #include<cmath>
+#include<cstdio>
+#include<cstring>
+#include<unistd.h>
+#include "stats.h"
+#include "trace.h"
+#include "observer.h"
 #include "BBN.h"
 
-double BBN::time;// time since T=T0 / sec
-double BBN::n0;// number density of nucleons at T_nu=1MeV
-double BBN::weak;// weak interaction strength (1 if tau=tau_n)
+thread_local double BBN::time;// time since T=T0 / sec
+thread_local double BBN::n0;// number density of nucleons at T_nu=1MeV
+thread_local double BBN::weak;// weak interaction strength (1 if tau=tau_n)
+thread_local double BBN::eps(1e-6);// error tolerance of integration
+thread_local bool BBN::log_abundance(false);// if true, integrate ln(y+TINY)
+thread_local bool BBN::nse_start(false);// if true, start from NSE (see init)
+thread_local double BBN::T_nse;// temperature of hand-off from NSE / MeV
+thread_local bool BBN::log_temperature(false);// if true, integrate in -ln(T)
+
+bool BBN::precision(const char *name)
+// set accuracy settings of calling thread to tier of given name
+// (applied by next init); return false if name is unknown
+{
+    for(int i=0; tier[i].name; i++) {
+        if(strcmp(tier[i].name, name)) continue;
+        prec = tier[i];
+        eps = prec.eps;
+        return true;
+    }
+    return false;
+}
+
+static double TINY(1e-30);// offset of y in logarithmic formulation
+static thread_local double t_nse;// time of hand-off from NSE / sec
+static thread_local Vec_DP w(2);// total neutrons and protons before hand-off
+static thread_local Vec_DP u_resume;// ln(y+TINY) of checkpoint in flight
+extern thread_local double h_resume;// see odeint.cpp
 
 void BBN::init(double eta, double T_init, double T_final, double N_nu, double tau)
 // eta = baryon to photon ratio (Kolb & Turner eq.3.104)
@@ -27,37 +57,69 @@ void BBN::init(double eta, double T_init, double T_final, double N_nu, double ta
     reaction_init();
     // initial condition
     time = expansion_time(T_init);
+    h_resume = 0;// discard checkpoint in flight (see restore)
+    u_resume = Vec_DP();
     y = 0.;
     y[n_index] = 1/(exp(Q/T_init) + 1);// neutron
     y[p_index] = 1/(1 + exp(-Q/T_init));// proton
+    if(!nse_start) return;
+    // nuclei are in NSE with n and p until T=T_nse, while n/p ratio
+    // evolves by weak interaction only; network starts at T=T_nse
+    T_nse = nse_temperature(T_init, T_final);
+    t_nse = expansion_time(T_nse);
+    w[0] = y[n_index];
+    w[1] = y[p_index];
+    nse(T_init, w[0], w[1]);
 }
 
-void BBN::diff_eq(double t, const Vec_DP& y, Vec_DP& f)
+static void weak_eq(double t, const Vec_DP& w, Vec_DP& f)
+// w = total number of neutrons and protons per nucleon
+// f = dw/dt by weak interaction
+{
+    double T(BBN::temperature(t));
+    f[0] = w[1]*BBN::proton_to_neutron(T) - w[0]*BBN::neutron_to_proton(T);
+    f[1] = -f[0];
+}
+
+static void weak_jac(double t, const Vec_DP& w, Vec_DP& fx, Mat_DP& fy)
+// jacobian of weak_eq
+{
+    double T(BBN::temperature(t)), h(BBN::prec.eps_jac*t);
+    double p_n(BBN::proton_to_neutron(T)), n_p(BBN::neutron_to_proton(T));
+    Vec_DP f(2);
+    weak_eq(t-h,w,f);
+    weak_eq(t+h,w,fx);
+    fx[0] = (fx[0]-f[0])/h/2;
+    fx[1] = -fx[0];
+    fy[0][0] = -n_p; fy[0][1] = p_n;
+    fy[1][0] = n_p; fy[1][1] = -p_n;
+}
+
+static void network_eq(double T, const Vec_DP& y, Vec_DP& f)
 // input:
-//   t = time since T=T0 / sec
+//   T = temperature / MeV
 //   y = number density of elements / that of nucleons
 // output:
 //   f = dy/dt (right hand side of differential equation)
 {
     int i,j;
-    double T, p_n, n_p, N, x[4], X[N_element], a;
-    Vec_DP r1(N_reaction), r2(N_reaction);
+    double p_n, n_p, N, x[4], X[BBN::N_element], a;
+    Vec_DP r1(BBN::N_reaction), r2(BBN::N_reaction);
     const int *id;
 
-    T = temperature(t);
-    p_n = proton_to_neutron(T);
-    n_p = neutron_to_proton(T);
-    reaction_rate(r1, r2, T);
+    p_n = BBN::proton_to_neutron(T);
+    n_p = BBN::neutron_to_proton(T);
+    BBN::reaction_rate(r1, r2, T);
     // number density of nucleons / cm^-3
-    N = n0*pow(neutrino_temperature(T), 3);
+    N = BBN::n0*pow(BBN::neutrino_temperature(T), 3);
     // number density of elements / cm^-3
-    for(i=0; i<N_element; i++) X[i] = N*y[i];
-    a = y[p_index]*p_n - y[n_index]*n_p;
+    for(i=0; i<BBN::N_element; i++) X[i] = N*y[i];
+    a = y[BBN::p_index]*p_n - y[BBN::n_index]*n_p;
     f = 0.;
-    f[n_index] += a;
-    f[p_index] -= a;
-    for(i=0; i<N_reaction; i++) {
-        id = index[i];
+    f[BBN::n_index] += a;
+    f[BBN::p_index] -= a;
+    for(i=0; i<BBN::N_reaction; i++) {
+        id = BBN::index[i];
         for(j=0; j<4; j++) x[j] = (id[j]<0 ? 1 : X[id[j]]);
         a = (r1[i]*x[0]*x[1] - r2[i]*x[2]*x[3])/N;
         // halve rate for identical particles
@@ -67,37 +129,29 @@ void BBN::diff_eq(double t, const Vec_DP& y, Vec_DP& f)
     }
 }
 
-void BBN::jac(double t, const Vec_DP& y, Vec_DP& fx, Mat_DP& fy)
-// jacobian of diff_eq, passed to stiff equation solver
-// input: same as diff_eq
-// output: fx = df/dt, fy = df/dy
+static void network_jac(double T, const Vec_DP& y, Mat_DP& fy)
+// input: same as network_eq
+// output: fy = df/dy (f is output of network_eq)
 {
-    static double EPS(1e-8);// for finite difference
     int i,j,k;
-    double T, p_n, n_p, N, x[4], X[N_element], a, h(EPS*t);
-    Vec_DP r1(N_reaction), r2(N_reaction), f(N_element);
+    double p_n, n_p, N, x[4], X[BBN::N_element], a;
+    Vec_DP r1(BBN::N_reaction), r2(BBN::N_reaction);
     const int *id;
 
-    // numerical derivative
-    diff_eq(t-h,y,f);
-    diff_eq(t+h,y,fx);
-    for(i=0; i<N_element; i++) fx[i] = (fx[i]-f[i])/h/2;
-    // analytic jacobian
-    T = temperature(t);
-    p_n = proton_to_neutron(T);
-    n_p = neutron_to_proton(T);
-    reaction_rate(r1, r2, T);
+    p_n = BBN::proton_to_neutron(T);
+    n_p = BBN::neutron_to_proton(T);
+    BBN::reaction_rate(r1, r2, T);
     // number density of nucleons / cm^-3
-    N = n0*pow(neutrino_temperature(T), 3);
+    N = BBN::n0*pow(BBN::neutrino_temperature(T), 3);
     // number density of elements / cm^-3
-    for(i=0; i<N_element; i++) X[i] = N*y[i];
+    for(i=0; i<BBN::N_element; i++) X[i] = N*y[i];
     fy = 0.;
-    fy[n_index][n_index] -= n_p;
-    fy[n_index][p_index] += p_n;
-    fy[p_index][n_index] += n_p;
-    fy[p_index][p_index] -= p_n;
-    for(i=0; i<N_reaction; i++) {
-        id = index[i];
+    fy[BBN::n_index][BBN::n_index] -= n_p;
+    fy[BBN::n_index][BBN::p_index] += p_n;
+    fy[BBN::p_index][BBN::n_index] += n_p;
+    fy[BBN::p_index][BBN::p_index] -= p_n;
+    for(i=0; i<BBN::N_reaction; i++) {
+        id = BBN::index[i];
         for(j=0; j<4; j++) x[j] = (id[j]<0 ? 1 : X[id[j]]);
         // halve rate for identical particles
         a = (id[0] == id[1] ? 0.5 : 1);
@@ -108,8 +162,457 @@ void BBN::jac(double t, const Vec_DP& y, Vec_DP& fx, Mat_DP& fy)
     }
 }
 
-void BBN::set_temperature(double T) {
-    double t(expansion_time(T));
-    odeint(y, diff_eq, jac, time, t, 1e-6);
+static void network_jac_vec(double T, const Vec_DP& y, const Vec_DP& v, Vec_DP& w)
+// input: T, y = same as network_eq
+//        v = vector (or empty)
+// output: w = (df/dy)*v (diagonal of df/dy if v is empty)
+//         by reaction table without forming df/dy
+// (rates are computed when diagonal is requested, i.e. once per step
+//  of stifbs, and kept for products at same T, since GMRES calls this
+//  many times at point of jacobian)
+{
+    static thread_local double T1(-1), p_n, n_p, N;
+    static thread_local Vec_DP r1, r2;
+    int i,j,k;
+    double x[4], X[BBN::N_element], a, b;
+    const int *id;
+    const int n(BBN::n_index), p(BBN::p_index);
+    bool d(v.size() == 0);
+
+    if(d || T != T1) {
+        r1 = r2 = Vec_DP(BBN::N_reaction);
+        p_n = BBN::proton_to_neutron(T);
+        n_p = BBN::neutron_to_proton(T);
+        BBN::reaction_rate(r1, r2, T);
+        // number density of nucleons / cm^-3
+        N = BBN::n0*pow(BBN::neutrino_temperature(T), 3);
+        T1 = T;
+    }
+    // number density of elements / cm^-3
+    for(i=0; i<BBN::N_element; i++) X[i] = N*y[i];
+    w = 0.;
+    if(d) { w[n] -= n_p; w[p] -= p_n; }
+    else {
+        a = p_n*v[p] - n_p*v[n];
+        w[n] += a;
+        w[p] -= a;
+    }
+    for(i=0; i<BBN::N_reaction; i++) {
+        id = BBN::index[i];
+        for(j=0; j<4; j++) x[j] = (id[j]<0 ? 1 : X[id[j]]);
+        // halve rate for identical particles
+        a = (id[0] == id[1] ? 0.5 : 1);
+        if(d) {
+            for(j=0; j<4; j++)
+                for(k=0; k<4; k++)
+                    if(id[j]>=0 && id[j]==id[k])
+                        w[id[j]] -= (j<2 ? a : -a)*(k<2 ? r1[i] : -r2[i])*x[k^1];
+            continue;
+        }
+        for(b=0, k=0; k<4; k++)// d(rate)/dy * v
+            if(id[k]>=0) b += (k<2 ? r1[i] : -r2[i])*x[k^1]*v[id[k]];
+        for(j=0; j<4; j++)
+            if(id[j]>=0) w[id[j]] -= (j<2 ? a : -a)*b;
+    }
+}
+
+void BBN::diff_eq(double t, const Vec_DP& y, Vec_DP& f)
+// input:
+//   t = time since T=T0 / sec
+//   y = number density of elements / that of nucleons
+// output:
+//   f = dy/dt (right hand side of differential equation)
+{ network_eq(temperature(t), y, f); }
+
+void BBN::jac(double t, const Vec_DP& y, Vec_DP& fx, Mat_DP& fy)
+// jacobian of diff_eq, passed to stiff equation solver
+// input: same as diff_eq
+// output: fx = df/dt, fy = df/dy
+// (fx or fy is not computed if its size is 0)
+{
+    if(fx.size()) {// numerical derivative
+        double h(prec.eps_jac*t);
+        Vec_DP f(N_element);
+        diff_eq(t-h,y,f);
+        diff_eq(t+h,y,fx);
+        for(int i=0; i<N_element; i++) fx[i] = (fx[i]-f[i])/h/2;
+    }
+    if(fy.nrows()) network_jac(temperature(t), y, fy);
+}
+
+void BBN::jac_vec(double t, const Vec_DP& y, const Vec_DP& v, Vec_DP& w)
+// product of jacobian df/dy of diff_eq and vector v for KRYLOV_SOLVER
+// output: w = (df/dy)*v (diagonal of df/dy if v is empty)
+{ network_jac_vec(temperature(t), y, v, w); }
+
+void BBN::diff_eq_lnT(double x, const Vec_DP& y, Vec_DP& f)
+// formulation of diff_eq in temperature, which is inverted from t
+// by tables only once in set_temperature (see log_temperature)
+// input: x = -ln(T/MeV), y is same as in diff_eq
+// output: f = dy/dx = (dy/dt)*(-dt/dlnT)
+{
+    double T(exp(-x)), s(cooling_time(T));
+    network_eq(T, y, f);
+    for(int i=0; i<N_element; i++) f[i] *= s;
+}
+
+void BBN::jac_lnT(double x, const Vec_DP& y, Vec_DP& fx, Mat_DP& fy)
+// jacobian of diff_eq_lnT
+// output: fx = df/dx, fy = df/dy
+{
+    int i,j;
+    double T(exp(-x)), s(cooling_time(T)), h(prec.eps_jac);
+    Vec_DP f(N_element);
+    diff_eq_lnT(x-h,y,f);
+    diff_eq_lnT(x+h,y,fx);
+    for(i=0; i<N_element; i++) fx[i] = (fx[i]-f[i])/h/2;
+    if(fy.nrows() == 0) return;
+    network_jac(T, y, fy);
+    for(i=0; i<N_element; i++)
+        for(j=0; j<N_element; j++) fy[i][j] *= s;
+}
+
+void BBN::jac_vec_lnT(double x, const Vec_DP& y, const Vec_DP& v, Vec_DP& w)
+// product of jacobian df/dy of diff_eq_lnT and vector v (see jac_vec)
+{
+    double T(exp(-x)), s(cooling_time(T));
+    network_jac_vec(T, y, v, w);
+    for(int i=0; i<N_element; i++) w[i] *= s;
+}
+
+void BBN::diff_eq_log(double t, const Vec_DP& u, Vec_DP& g)
+// logarithmic formulation of diff_eq
+// input: u = ln(y+TINY) (y is same as in diff_eq)
+// output: g = du/dt
+// (y+TINY is clipped to [TINY,e] in case u goes astray in trial steps)
+{
+    int i;
+    Vec_DP y(N_element), e(N_element);
+    for(i=0; i<N_element; i++) {
+        e[i] = MAX(exp(MIN(u[i], 1.)), TINY);
+        y[i] = e[i] - TINY;
+    }
+    diff_eq(t,y,g);
+    for(i=0; i<N_element; i++) g[i] /= e[i];
+}
+
+void BBN::jac_log(double t, const Vec_DP& u, Vec_DP& gx, Mat_DP& gy)
+// jacobian of diff_eq_log
+// output: gx = dg/dt, gy = dg/du
+{
+    int i,j;
+    Vec_DP y(N_element), f(N_element), e(N_element);
+    for(i=0; i<N_element; i++) {
+        e[i] = MAX(exp(MIN(u[i], 1.)), TINY);
+        y[i] = e[i] - TINY;
+    }
+    jac(t,y,gx,gy);
+    diff_eq(t,y,f);
+    for(i=0; i<N_element; i++) {
+        gx[i] /= e[i];
+        for(j=0; j<N_element; j++) gy[i][j] *= e[j]/e[i];
+        gy[i][i] -= f[i]/e[i];
+    }
+}
+
+extern thread_local void (*step_hook)(double, const Vec_DP&, double, double);
+extern thread_local int step_order;
+extern thread_local double yabs;// see odeint.cpp
+static thread_local double t_end;// end of integration in set_temperature
+static thread_local double t_checkpoint;// wall time of last checkpoint
+// -ln(T) at end of last call of advance in ln(T), which is reused,
+// since T(t(T)) != T by error of tables
+static thread_local double time_lnT(-1), x_lnT;
+// eps and log_abundance of caller of set_temperature, which are saved
+// in checkpoint instead of those changed during retry
+static thread_local bool retrying, log_call;
+static thread_local double eps_call;
+static bool write_checkpoint(double, const Vec_DP*, double);
+
+static void step_done(double t, const Vec_DP& u, double h, double h_next)
+// pass state after accepted step of odeint to BBN::observer, and
+// write checkpoint if checkpoint_interval has passed (but not if u is
+// of formulation toggled by retry)
+{
+    if(BBN::observer && BBN::log_abundance) {// u = ln(y+TINY) is converted to y
+        static thread_local Vec_DP y(BBN::N_element);
+        for(int i=0; i<BBN::N_element; i++) y[i] = MAX(exp(u[i]) - TINY, 0.);
+        BBN::observer->observe(step_view{t, BBN::temperature(t), y, h, step_order});
+    }
+    else if(BBN::observer)
+        BBN::observer->observe(step_view{t, BBN::temperature(t), u, h, step_order});
+    if(BBN::checkpoint_file && t != t_end
+       && !(retrying && BBN::log_abundance != log_call)
+       && solver_stats::clock() - t_checkpoint >= BBN::checkpoint_interval
+       && !write_checkpoint(t, &u, h_next))
+        std::cerr << "cannot write " << BBN::checkpoint_file << '\n';
+}
+
+static void step_done_lnT(double x, const Vec_DP& y, double h, double)
+// step_done of diff_eq_lnT (x = -ln(T/MeV), h = step of x), where
+// checkpoint in flight is not written
+{
+    double T(exp(-x));
+    BBN::observer->observe(step_view{BBN::expansion_time(T), T, y,
+                h*BBN::cooling_time(T), step_order});
+}
+
+void BBN::advance(double T)
+// integrate network until temperature T / MeV without retry
+// (nr_error is thrown if solver fails)
+{
+    TRACE_ARG("set_temperature", "T", T);
+    double t(expansion_time(T)), t0(stats.on ? stats.clock() : 0);
+    if(nse_start && time < t_nse) {// before hand-off from NSE
+        odeint(w, weak_eq, weak_jac, time, MIN(t, t_nse), eps);
+        if(t <= t_nse) {
+            nse(T, w[0], w[1]);
+            time = t;
+            if(stats.on) stats.t_network += stats.clock() - t0;
+            return;
+        }
+        nse(T_nse, w[0], w[1]);
+        time = t_nse;
+    }
+    if((observer || checkpoint_file) && (log_abundance || qss_ratio <= 0))
+        step_hook = step_done;// not called on steps of reduced system of QSS
+    t_end = t;
+    if(log_abundance) {
+        // error of u is measured by |u|+1 instead of |u|+|h*du/dt|
+        int i;
+        Vec_DP u(N_element);
+        if(u_resume.size()) { u = u_resume; u_resume = Vec_DP(); }
+        else for(i=0; i<N_element; i++) u[i] = log(y[i] + TINY);
+        yabs = 1;
+        odeint(u, diff_eq_log, jac_log, time, t, eps);
+        yabs = 0;
+        for(i=0; i<N_element; i++) y[i] = MAX(exp(u[i]) - TINY, 0.);
+    }
+    else if(qss_ratio > 0) integrate_qss(time, t);
+    else if(log_temperature) {
+        if(time != time_lnT) x_lnT = -log(temperature(time));
+        h_resume = 0;// step of checkpoint in flight is in time
+        if(step_hook) step_hook = (observer ? step_done_lnT : 0);
+        odeint(y, diff_eq_lnT, jac_lnT, jac_vec_lnT, x_lnT, -log(T), eps);
+        time_lnT = t;
+        x_lnT = -log(T);
+    }
+    else odeint(y, diff_eq, jac, jac_vec, time, t, eps);
+    step_hook = 0;
     time = t;
-}
\ No newline at end of file
+    if(stats.on) stats.t_network += stats.clock() - t0;
+}
+
+// formulation is kept by default, so that a result is always of the
+// method asked for (toggle_log=true rescues more runs, but silently)
+thread_local BBN_retry BBN::retry = { 2, 0.1, false };
+thread_local int BBN::retries;
+thread_local std::string BBN::error;
+
+int BBN::set_temperature(double T)
+// integrate network until temperature T / MeV;
+// if solver fails (nrerror), state is restored and integration is
+// retried by retry policy (with eps and log_abundance changed only
+// during the retry); return 0 if succeeded, or status of nr_error
+// (see nr.h) if all retries failed, in which case state is that
+// before the call and error is set to message of last failure
+{
+    int k, status(0);
+    double eps0(eps), time0(time);
+    bool log0(log_abundance);
+    Vec_DP ys(y), ws(w);
+    retries = 0;
+    eps_call = eps0;
+    log_call = log0;
+    for(k=0; k<=retry.n; k++) {
+        if(k) {
+            retrying = true;
+            retries++;
+            eps *= retry.eps_factor;
+            if(retry.toggle_log) log_abundance = !log_abundance;
+        }
+        try { advance(T); status = 0; break; }
+        catch(const nr_error& e) { status = e.status; error = e.what(); }
+        step_hook = 0;
+        yabs = 0;
+        h_resume = 0;
+        u_resume = Vec_DP();
+        y = ys; w = ws; time = time0;
+    }
+    retrying = false;
+    eps = eps0;
+    log_abundance = log0;
+    if(status == 0) error.clear();
+    return status;
+}
+// binary checkpoint file:
+//   checkpoint_header, checkpoint_state, y[N_element],
+//   state of stifbs[n_state - N_element], checkpoint_data[n_data]
+// where checkpoint_state is written and read as it is by
+// write_checkpoint and restore (no field is indexed by position);
+// elements in QSS are not saved, since integrate_qss selects them
+// again at start of each call, and checkpoint in flight is not written
+// while they are fixed
+struct checkpoint_header {
+    char magic[4];// "BBNK"
+    int version;// CHECKPOINT_VERSION
+    int N_element;// number of elements
+    int n_fixed;// sizeof(checkpoint_state)
+    int n_state;// number of doubles of y and state of stifbs
+    int n_data;// number of doubles of checkpoint_data
+};
+struct checkpoint_state {
+    double T_init, T_final, N_nu;// inputs of interp_init
+    int tier;// index of prec in BBN::tier (-1 if not a tier)
+    BBN_precision prec;// accuracy settings (name is set from tier)
+    double n0, weak, eps;// parameters of integration
+    bool log_abundance, nse_start, log_temperature;
+    int linear_solver;
+    double qss_ratio, qss_step;
+    double T_nse, t_nse, w[2];// hand-off from NSE
+    double time;// time of y / sec
+    double h;// next step size of odeint (0 if not in flight)
+    double time_lnT, x_lnT;// state of advance in ln(T)
+};
+#define CHECKPOINT_MAGIC "BBNK"
+const int CHECKPOINT_VERSION(5);
+
+thread_local const char *BBN::checkpoint_file(0);
+thread_local double BBN::checkpoint_interval(1);
+thread_local std::vector<double> BBN::checkpoint_data;
+
+void stifbs_save(std::vector<double>&);
+bool stifbs_load(const double*&, const double*);
+
+static bool write_checkpoint(double t, const Vec_DP *u, double h)
+// write state to BBN::checkpoint_file
+// input: if u is 0, state between calls of set_temperature, else
+//        state in flight after step of odeint to time t, where
+//        u = dependent variable, h = next step size of odeint
+{
+    int i,k;
+    const Vec_DP& z(u ? *u : BBN::y);
+    checkpoint_state st;
+    memset(&st, 0, sizeof(st));// padding is written too
+    BBN::table_inputs(st.T_init, st.T_final, st.N_nu);
+    st.prec = BBN::prec;
+    for(k=0; BBN::tier[k].name; k++)
+        if(st.prec.name && strcmp(BBN::tier[k].name, st.prec.name)==0) break;
+    st.tier = (BBN::tier[k].name ? k : -1);
+    st.prec.name = 0;// pointer is not saved
+    st.n0 = BBN::n0;
+    st.weak = BBN::weak;
+    st.eps = (retrying ? eps_call : BBN::eps);
+    st.log_abundance = (retrying ? log_call : BBN::log_abundance);
+    st.nse_start = BBN::nse_start;
+    st.log_temperature = BBN::log_temperature;
+    st.linear_solver = linear_solver;
+    st.qss_ratio = BBN::qss_ratio;
+    st.qss_step = BBN::qss_step;
+    st.T_nse = BBN::T_nse;
+    st.t_nse = t_nse;
+    st.w[0] = w[0];
+    st.w[1] = w[1];
+    st.time = (u ? t : BBN::time);
+    st.h = (u ? h : 0);
+    st.time_lnT = time_lnT;
+    st.x_lnT = x_lnT;
+    std::vector<double> s;
+    for(i=0; i<BBN::N_element; i++) s.push_back(z[i]);
+    stifbs_save(s);
+    checkpoint_header hd;
+    memcpy(hd.magic, CHECKPOINT_MAGIC, 4);
+    hd.version = CHECKPOINT_VERSION;
+    hd.N_element = BBN::N_element;
+    hd.n_fixed = sizeof(st);
+    hd.n_state = s.size();
+    hd.n_data = BBN::checkpoint_data.size();
+    std::string tmp(std::string(BBN::checkpoint_file) + ".tmp");
+    FILE *fp(fopen(tmp.c_str(), "wb"));
+    if(!fp) return false;
+    bool ok(fwrite(&hd, sizeof(hd), 1, fp) == 1
+            && fwrite(&st, sizeof(st), 1, fp) == 1
+            && fwrite(s.data(), sizeof(double), s.size(), fp) == s.size()
+            && fwrite(BBN::checkpoint_data.data(), sizeof(double), hd.n_data, fp)
+            == size_t(hd.n_data)
+            && fflush(fp) == 0 && fsync(fileno(fp)) == 0);
+    ok = (fclose(fp) == 0 && ok && rename(tmp.c_str(), BBN::checkpoint_file) == 0);
+    if(!ok) remove(tmp.c_str());
+    t_checkpoint = solver_stats::clock();
+    return ok;
+}
+
+bool BBN::checkpoint(bool force)
+// write state of integration (after last set_temperature) and
+// checkpoint_data to checkpoint_file if force is true or
+// checkpoint_interval has passed since last checkpoint;
+// set_temperature also writes state in flight after steps of odeint
+// at checkpoint_interval, which bounds cost of checkpoints;
+// file is replaced atomically (written to file.tmp and renamed)
+// return false if file is not written
+{
+    if(!checkpoint_file) return false;
+    if(!force && solver_stats::clock() - t_checkpoint < checkpoint_interval)
+        return false;
+    return write_checkpoint(time, 0, 0);
+}
+
+bool BBN::restore(const char *file)
+// restore state of integration, accuracy settings and checkpoint_data
+// from file written by checkpoint, and remake interpolation tables by
+// interp_init with saved inputs; if file is written in flight,
+// following set_temperature (with same T as interrupted) continues
+// integration from the step, so that results are bit-identical to
+// those of uninterrupted run (time < expansion_time(T) in this case)
+// return false if file can not be read
+{
+    int i;
+    checkpoint_header hd;
+    checkpoint_state st;
+    FILE *fp(fopen(file, "rb"));
+    if(!fp) return false;
+    bool ok(fread(&hd, sizeof(hd), 1, fp) == 1
+            && strncmp(hd.magic, CHECKPOINT_MAGIC, 4)==0
+            && hd.version == CHECKPOINT_VERSION && hd.N_element == N_element
+            && hd.n_fixed == int(sizeof(st))
+            && hd.n_state >= N_element && hd.n_data >= 0);
+    std::vector<double> s(ok ? hd.n_state : 0), d(ok ? hd.n_data : 0);
+    ok = (ok && fread(&st, sizeof(st), 1, fp) == 1
+          && fread(s.data(), sizeof(double), s.size(), fp) == s.size()
+          && fread(d.data(), sizeof(double), d.size(), fp) == d.size());
+    fclose(fp);
+    if(!ok) return false;
+    const double *a(s.data()), *p(a + N_element);
+    if(!stifbs_load(p, a + s.size()) || p != a + s.size()) return false;
+    const char *name(st.tier >= 0 ? tier[st.tier].name : prec.name);
+    prec = st.prec;
+    prec.name = name;
+    n0 = st.n0;
+    weak = st.weak;
+    eps = st.eps;
+    log_abundance = st.log_abundance;
+    nse_start = st.nse_start;
+    log_temperature = st.log_temperature;
+    linear_solver = st.linear_solver;
+    qss_ratio = st.qss_ratio;
+    qss_step = st.qss_step;
+    T_nse = st.T_nse;
+    t_nse = st.t_nse;
+    w[0] = st.w[0];
+    w[1] = st.w[1];
+    interp_init(st.T_init, st.T_final, st.N_nu);
+    reaction_init();
+    time = st.time;
+    h_resume = st.h;
+    time_lnT = st.time_lnT;
+    x_lnT = st.x_lnT;
+    u_resume = Vec_DP();
+    for(i=0; i<N_element; i++) y[i] = a[i];
+    if(h_resume != 0 && log_abundance) {// y is u = ln(y+TINY)
+        u_resume = y;
+        for(i=0; i<N_element; i++) y[i] = MAX(exp(u_resume[i]) - TINY, 0.);
+    }
+    checkpoint_data.swap(d);
+    t_checkpoint = solver_stats::clock();
+    return true;
+}
@@ -1,7 +1,9 @@
 #ifndef __BBN_h__
 #define __BBN_h__
 
+#include<vector>
 #include "nr.h"
+#include "stifbs.h"
 #include "constants.h"
 
 void expansion_init(double, double=3);
@@ -11,6 +13,12 @@ void weak_rate(double&, double&, double, double, double=tau_n);
 
 void spline(const Vec_DP &x, const Vec_DP &y, double yp1, double ypn, Vec_DP &y2);
 double splint(const Vec_DP &xa, const Vec_DP &ya, const Vec_DP &y2a, double x);
+void pchip(const Vec_DP &x, const Vec_DP &y, Vec_DP &d);
+double pchint(const Vec_DP &xa, const Vec_DP &ya, const Vec_DP &da, double x);
+
+// method of interpolation tables (see BBN::interp_init)
+enum { CUBIC_SPLINE,// natural cubic spline
+       MONOTONE_CUBIC };// shape-preserving piecewise cubic (pchip)
 
 struct particle {
     double mass;
@@ -21,45 +29,117 @@ struct particle {
     inline bool operator==(const particle& p) { return name==p.name; }
 };
 
+struct step_observer;// see observer.h
+
+struct BBN_table {// copy of interpolation variables
+    double T_init, T_final, N_nu;// parameters of interp_init
+    int tier;// index of precision tier (set by user)
+    Vec_DP x0,x1,y0,y1,y2,y3,y4,y5,dy0,dy1,dy2,dy3,dy4,dy5;
+};
+
+struct BBN_precision {// accuracy settings (see BBN::precision)
+    const char *name;// name of tier
+    int N_quad;// number of nodes for Gauss-Laguerre quadrature
+    int N_grid;// number of grid points (max number if eps_grid > 0)
+    double eps_grid;// error tolerance of adaptive grid (0 if uniform)
+    int interp;// CUBIC_SPLINE or MONOTONE_CUBIC
+    double eps_expansion;// error tolerance of expansion ODE
+    double eps;// error tolerance of nuclear network
+    double eps_jac;// relative step of numerical derivative in jac
+    double budget;// max relative error of mass fractions (vs reference)
+};
+
+struct BBN_retry {// retry policy of set_temperature after solver error
+    int n;// max number of retries
+    double eps_factor;// eps is multiplied by eps_factor at each retry
+    bool toggle_log;// if true, log_abundance is switched at each retry
+};
+
 struct BBN {
     static int N_element;// number of elements
     static int N_reaction;// number of nuclear reactions
-    static int n_index;// index of neutron
-    static int p_index;// index of proton
-    static Mat_INT index;// table of particles
+    static thread_local int n_index;// index of neutron
+    static thread_local int p_index;// index of proton
+    static thread_local Mat_INT index;// table of particles
     static particle element[];// list of synthesized elements
     static particle reaction[][4];// list of nuclear reactions
     static void reaction_init();
     static void reaction_rate(Vec_DP&, double);
     static void reaction_rate(Vec_DP&, Vec_DP&, double);
     // interpolation variables
-    static Vec_DP x0,x1,y0,y1,y2,y3,y4,dy0,dy1,dy2,dy3,dy4;
+    static thread_local Vec_DP x0,x1,y0,y1,y2,y3,y4,y5,dy0,dy1,dy2,dy3,dy4,dy5;
+    static thread_local int interpolation;// method of tables (prec.interp)
+    static thread_local double grid_error;// estimated error of tables
+    static int table_threads;// number of threads used by interp_init
     static void interp_init(double, double, double);
+    static void save_table(BBN_table&);
+    static void table_inputs(double&, double&, double&);
+    static void load_table(const BBN_table&);
 
-    static Vec_DP y;// abundance of elements (dependent variable)
-    static double time;// time since T=T0 / sec
-    static double n0;// number density of nucleons at T_nu=1MeV
-    static double weak;// weak interaction strength (1 if tau=tau_n)
+    // state of integration (separate for each thread)
+    static thread_local Vec_DP y;// abundance of elements (dependent variable)
+    static thread_local double time;// time since T=T0 / sec
+    static thread_local double n0;// number density of nucleons at T_nu=1MeV
+    static thread_local double weak;// weak interaction strength (1 if tau=tau_n)
+    static thread_local double eps;// error tolerance of integration
+    static thread_local bool log_abundance;// if true, integrate ln(y+TINY)
+    static thread_local bool nse_start;// if true, start from NSE (see init)
+    static thread_local double T_nse;// temperature of hand-off from NSE / MeV
+    static thread_local bool log_temperature;// if true, integrate in -ln(T)
+    static thread_local double qss_ratio;// if >0, use QSS (see integrate_qss)
+    static thread_local double qss_step;// ratio of T between QSS selection
+    static thread_local step_observer *observer;// called on accepted steps
+    static thread_local BBN_precision prec;// accuracy settings
+    static const BBN_precision tier[];// named settings (ended by name=0)
+    static bool precision(const char*);
     static void init(double, double, double, double=3, double=tau_n);
     static void diff_eq(double, const Vec_DP&, Vec_DP&);
     static void jac(double, const Vec_DP&, Vec_DP&, Mat_DP&);
-    static void set_temperature(double);
+    static void diff_eq_log(double, const Vec_DP&, Vec_DP&);
+    static void jac_log(double, const Vec_DP&, Vec_DP&, Mat_DP&);
+    static void diff_eq_lnT(double, const Vec_DP&, Vec_DP&);
+    static void jac_lnT(double, const Vec_DP&, Vec_DP&, Mat_DP&);
+    static void jac_vec(double, const Vec_DP&, const Vec_DP&, Vec_DP&);
+    static void jac_vec_lnT(double, const Vec_DP&, const Vec_DP&, Vec_DP&);
+    static int set_temperature(double);
+    static void advance(double);
+    static thread_local BBN_retry retry;// retry policy of set_temperature
+    static thread_local int retries;// retries in last set_temperature
+    static thread_local std::string error;// message of last failure
+    static void nse(double, double, double);
+    static double nse_temperature(double, double, double=1e3);
+    static void integrate_qss(double, double);
+
+    // checkpoint of integration (see BBN::checkpoint)
+    static thread_local const char *checkpoint_file;// 0 if not written
+    static thread_local double checkpoint_interval;// min wall time / sec
+    static thread_local std::vector<double> checkpoint_data;// user data
+    static bool checkpoint(bool=true);
+    static bool restore(const char*);
 
+    inline static double interp(const Vec_DP& x, const Vec_DP& y,
+                                const Vec_DP& dy, double t)
+    // interpolate table (x,y,dy) at t
+    { return interpolation == MONOTONE_CUBIC ?
+            pchint(x,y,dy,t) : splint(x,y,dy,t); }
     inline static double temperature(double t)
     // given time t / sec, return temperature / MeV
-    { return splint(x0,y0,dy0,t); }
+    { return interp(x0,y0,dy0,t); }
     inline static double expansion_time(double T)
     // given temperature T / MeV, return time since T=T_init / sec
-    { return splint(x1,y1,dy1,T); }
+    { return interp(x1,y1,dy1,T); }
     inline static double neutrino_temperature(double T)
     // given temperature T / MeV, return neutrino temperature / MeV
-    { return splint(x1,y2,dy2,T)*T; }
+    { return interp(x1,y2,dy2,T)*T; }
     inline static double proton_to_neutron(double T)
     // given temperature T / MeV, return weak interaction rate p_n / sec^-1
-    { return splint(x1,y3,dy3,T)*weak; }
+    { return interp(x1,y3,dy3,T)*weak; }
     inline static double neutron_to_proton(double T)
     // given temperature T / MeV, return weak interaction rate n_p / sec^-1
-    { return splint(x1,y4,dy4,T)*weak; }
+    { return interp(x1,y4,dy4,T)*weak; }
+    inline static double cooling_time(double T)
+    // given temperature T / MeV, return -dt/dln(T) / sec
+    { return interp(x1,y5,dy5,T); }
     inline static double mass_fraction(int i)
     // given index i, return mass fraction of element i
     { return element[i].A * y[i]; }
@@ -74,4 +154,9 @@ void odeint(Vec_DP& y, void f(double, const Vec_DP& y, Vec_DP& f),
             void jac(double, const Vec_DP&, Vec_DP&, Mat_DP&),
             double a, double b, double eps);
 
+void odeint(Vec_DP& y, void f(double, const Vec_DP& y, Vec_DP& f),
+            void jac(double, const Vec_DP&, Vec_DP&, Mat_DP&),
+            void jacvec(double, const Vec_DP&, const Vec_DP&, Vec_DP&),
+            double a, double b, double eps);
+
 #endif // _BBN_h__
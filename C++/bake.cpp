@@ -0,0 +1,67 @@
+// generate baked.cpp (see baked.h): Gauss-Laguerre nodes and weights
+// for N_quad of every tier, and interpolation tables of interp_init
+// for default inputs (T_init=10, T_final=0.01, N_nu=3 as in job.h)
+// with accuracy of every tier, as constexpr arrays
+// usage: bake > baked.cpp
+// (bake itself is linked with nobake.o, so that it makes tables)
+
+#include<cstdio>
+#include "BBN.h"
+
+static void array(const char *name, const Vec_DP& v)
+{
+    printf("static constexpr double %s[] = {", name);
+    for(int i=0; i<v.size(); i++)
+        printf("%s%.17g", (i%4 ? ", " : (i ? ",\n    " : "\n    ")), v[i]);
+    printf("\n};\n");
+}
+
+int main() {
+    const double T_init(10), T_final(0.01), N_nu(3);
+    const char *v[] = { "x0", "x1", "y0", "y1", "y2", "y3", "y4", "y5",
+                        "dy0", "dy1", "dy2", "dy3", "dy4", "dy5" };
+    int i,k;
+    char name[32];
+    BBN_table a;
+    printf("// generated by bake (see bake.cpp); do not edit\n\n");
+    printf("#include \"baked.h\"\n\n");
+    for(i=0; BBN::tier[i].name; i++) {
+        int N(BBN::tier[i].N_quad);
+        Vec_DP x(N), w(0.,N);
+        gaulag(x, w, 0);
+        snprintf(name, sizeof(name), "quad%d_x", i); array(name, x);
+        snprintf(name, sizeof(name), "quad%d_w", i); array(name, w);
+    }
+    for(i=0; BBN::tier[i].name; i++) {
+        BBN::prec = BBN::tier[i];
+        BBN::interp_init(T_init, T_final, N_nu);
+        BBN::save_table(a);
+        const Vec_DP *t[] = { &a.x0, &a.x1, &a.y0, &a.y1, &a.y2, &a.y3,
+                              &a.y4, &a.y5, &a.dy0, &a.dy1, &a.dy2,
+                              &a.dy3, &a.dy4, &a.dy5 };
+        for(k=0; k<14; k++) {
+            snprintf(name, sizeof(name), "table%d_%s", i, v[k]);
+            array(name, *t[k]);
+        }
+        printf("static constexpr double table%d_grid_error = %.17g;\n",
+               i, BBN::grid_error);
+        printf("static constexpr int table%d_n = %d;\n", i, a.x0.size());
+    }
+    printf("\nextern const baked_quadrature baked_quad[] = {\n");
+    for(i=0; BBN::tier[i].name; i++)
+        printf("    { %d, quad%d_x, quad%d_w },\n", BBN::tier[i].N_quad, i, i);
+    printf("    { 0 }\n};\n");
+    printf("\nextern const baked_table baked_tables[] = {\n");
+    for(i=0; BBN::tier[i].name; i++) {
+        const BBN_precision& p(BBN::tier[i]);
+        printf("    { \"%s\", %.17g, %.17g, %.17g, %d, %d, %.17g, %d, %.17g,\n"
+               "      table%d_grid_error, table%d_n, {\n", p.name, T_init, T_final,
+               N_nu, p.N_quad, p.N_grid, p.eps_grid, p.interp,
+               p.eps_expansion, i, i);
+        for(k=0; k<14; k++)
+            printf("%s table%d_%s", (k%4 ? "," : (k ? ",\n       " : "       ")), i, v[k]);
+        printf(" } },\n");
+    }
+    printf("    { 0 }\n};\n");
+    return 0;
+}
@@ -0,0 +1,31 @@
+// tables compiled into the library, so that default runs start with
+// no setup work: baked.cpp is generated by bake.cpp (make baked.cpp),
+// and nobake.cpp has empty lists (link it instead of baked.o to make
+// every table at run time, e.g. make fig5-6 BAKE=nobake.o); fig1, fig2,
+// grid (which measures making of tables), bake and pybbn always link
+// nobake
+
+#ifndef __baked_h__
+#define __baked_h__
+
+struct baked_quadrature {// Gauss-Laguerre nodes and weights (alf=0)
+    int N;// number of nodes
+    const double *x, *w;
+};
+
+struct baked_table {// interpolation variables made by BBN::interp_init
+    const char *tier;// name of tier used by bake
+    double T_init, T_final, N_nu;// inputs of interp_init
+    int N_quad, N_grid;// accuracy of interp_init (see BBN_precision)
+    double eps_grid;
+    int interp;
+    double eps_expansion;
+    double grid_error;// BBN::grid_error
+    int n;// number of nodes
+    const double *v[14];// x0,x1,y0,...,y5,dy0,...,dy5
+};
+
+extern const baked_quadrature baked_quad[];// ended by N=0
+extern const baked_table baked_tables[];// ended by tier=0
+
+#endif // __baked_h__
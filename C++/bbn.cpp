@@ -0,0 +1,99 @@
+// batch driver: read jobs (one JSON object per line, see job.h)
+// from file or stdin, solve them on a pool of worker threads and
+// write results (one JSON object per line) to stdout in completion order
+// usage: bbn [-j threads] [-t trace] [-m dir [-M megabytes]] [file]
+//   -t: write timeline trace of workers to file (if compiled with -DBBN_TRACE)
+//   -m dir: recall results from store in dir and save new results to
+//           it (see memo.h); statistics of store are printed to stderr
+//   -M megabytes: max size of store (default 1024)
+// each worker keeps its interpolation tables and solver state, so that
+// consecutive jobs with same (T_init, T_final, N_nu) skip interp_init;
+// results are written by async_writer, so that workers do not wait
+// for stdout nor for each other
+
+#include<cstdlib>
+#include<cstring>
+#include<fstream>
+#include<thread>
+#include<mutex>
+#include<condition_variable>
+#include<deque>
+#include "job.h"
+#include "memo.h"
+#include "trace.h"
+#include "writer.h"
+#include "BBN.h"
+
+static std::mutex lock;// for queue
+static std::condition_variable ready, space;
+static std::deque<std::string> queue;// lines to be processed
+static size_t capacity;// max size of queue
+static bool done(false);// end of input
+static async_writer *out;
+
+static void worker()
+{
+    std::string line, err, s;
+    job j;
+    job_result r;
+    for(;;) {
+        {
+            std::unique_lock<std::mutex> l(lock);
+            ready.wait(l, []{ return !queue.empty() || done; });
+            if(queue.empty()) return;
+            line.swap(queue.front());
+            queue.pop_front();
+        }
+        space.notify_one();
+        if(!j.parse(line, err)) { r.id = j.id; r.error = err; }
+        else if(!recall_job(j, r)) run_job(j, r);
+        r.format(s);
+        out->write(s);
+    }
+}
+
+int main(int argc, char **argv) {
+    int i, n(std::thread::hardware_concurrency());
+    std::ifstream f;
+    std::istream *in(&std::cin);
+    std::string line;
+    const char *trace(0), *memo(0);
+    double memo_size(1024);
+    std::vector<std::thread> pool;
+    for(i=1; i<argc; i++) {
+        if(strcmp(argv[i], "-j")==0 && i+1<argc) n = atoi(argv[++i]);
+        else if(strcmp(argv[i], "-t")==0 && i+1<argc) trace = argv[++i];
+        else if(strcmp(argv[i], "-m")==0 && i+1<argc) memo = argv[++i];
+        else if(strcmp(argv[i], "-M")==0 && i+1<argc) memo_size = atof(argv[++i]);
+        else if(strcmp(argv[i], "-")) {
+            f.open(argv[i]);
+            if(!f) { std::cerr << "cannot read " << argv[i] << '\n'; return 1; }
+            in = &f;
+        }
+    }
+    if(n<1) n = 1;
+    if(memo) job_memo = new memo_store(memo, long(memo_size*(1<<20)));
+    // share cores among workers when tables are built
+    BBN::table_threads = MAX(1, int(std::thread::hardware_concurrency())/n);
+    capacity = 2*n;
+    async_writer w(std::cout);
+    out = &w;
+    for(i=0; i<n; i++) pool.push_back(std::thread(worker));
+    while(std::getline(*in, line)) {
+        if(line.find_first_not_of(" \t\r") == std::string::npos) continue;
+        std::unique_lock<std::mutex> l(lock);
+        space.wait(l, []{ return queue.size() < capacity; });
+        queue.push_back(line);
+        l.unlock();
+        ready.notify_one();
+    }
+    {
+        std::lock_guard<std::mutex> l(lock);
+        done = true;
+    }
+    ready.notify_all();
+    for(i=0; i<n; i++) pool[i].join();
+    if(trace) TRACE_DUMP(trace);
+    if(job_memo) job_memo->print(std::cerr);
+    return 0;
+}
@@ -0,0 +1,40 @@
+// convert columnar binary file (see column.h) to space separated text
+// usage: bbnc2txt file [precision]
+
+#include<cstdlib>
+#include<iostream>
+#include "column.h"
+
+int main(int argc, char **argv) {
+    int i,j,k;
+    column_reader f;
+    if(argc<2) {
+        std::cerr << "usage: bbnc2txt file [precision]\n";
+        return 1;
+    }
+    if(!f.open(argv[1])) {
+        std::cerr << "cannot read " << argv[1] << '\n';
+        return 1;
+    }
+    if(argc>=3) std::cout.precision(atoi(argv[2]));
+    for(j=0; j<int(f.param.size()); j++)
+        std::cout << "# " << f.param[j].name << " = " << f.param[j].value
+                  << ' ' << f.param[j].unit << '\n';
+    std::cout << '#';
+    for(j=0; j<f.n_col(); j++) {
+        std::cout << ' ' << f.info[j].name;
+        if(f.info[j].unit[0]) std::cout << '/' << f.info[j].unit;
+    }
+    std::cout << '\n';
+    std::vector<std::vector<double> > tmp(f.n_col());
+    std::vector<const double*> x(f.n_col());
+    for(k=0; k<f.n_chunk(); k++) {
+        for(j=0; j<f.n_col(); j++) x[j] = f.data(k, j, tmp[j]);
+        for(i=0; i<f.n_row(k); i++) {
+            std::cout << x[0][i];
+            for(j=1; j<f.n_col(); j++) std::cout << ' ' << x[j][i];
+            std::cout << '\n';
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,267 @@
+// query server: keep BBN engine resident and answer requests
+// on a unix domain socket
+// usage: bbnd [-j threads] [-c cache] [-q queue] [-m dir [-M megabytes]]
+//             [socket]
+//   (default socket /tmp/bbnd.sock)
+//   -q queue: max number of pending requests (default 1024); when queue
+//             is full, readers stop reading until workers catch up, so
+//             that clients are throttled by the socket
+//   -m dir: recall results from store in dir before solving, and save
+//           new results to it (see memo.h)
+//   -M megabytes: max size of store (default 1024)
+// protocol: each request is one line, answered by one line
+//   job (JSON object, see job.h; optional "deadline_ms")
+//     -> result as printed by bbn (tagged with id, in completion order)
+//   "stats" -> counters and latency histograms
+// interpolation tables for recently used (T_init, T_final, N_nu, precision)
+// are kept in LRU cache shared by worker threads
+
+#include<cstdio>
+#include<cstdlib>
+#include<cstring>
+#include<cmath>
+#include<sstream>
+#include<thread>
+#include<mutex>
+#include<condition_variable>
+#include<deque>
+#include<list>
+#include<map>
+#include<memory>
+#include<atomic>
+#include<csignal>
+#include<unistd.h>
+#include<sys/socket.h>
+#include<sys/un.h>
+#include "job.h"
+#include "memo.h"
+#include "stats.h"
+#include "BBN.h"
+
+struct connection {
+    int fd;
+    std::mutex lock;// for writing
+    connection(int f) : fd(f) {;}
+    ~connection() { close(fd); }
+    void send(const std::string& s) {
+        std::lock_guard<std::mutex> l(lock);
+        for(size_t k(0); k < s.size();) {
+            ssize_t n(::send(fd, s.data()+k, s.size()-k, MSG_NOSIGNAL));
+            if(n <= 0) return;// client has gone
+            k += n;
+        }
+    }
+};
+
+struct request {
+    std::shared_ptr<connection> conn;
+    std::string line;
+    double arrival;// solver_stats::clock() at arrival / sec
+};
+
+struct histogram {// latency histogram with buckets of power of 2 usec
+    static constexpr int N = 32;
+    std::atomic<long> count[N];
+    histogram() { for(int i=0; i<N; i++) count[i] = 0; }
+    void add(double sec) {
+        int i(sec > 1e-6 ? int(log2(sec*1e6)) + 1 : 0);
+        count[MIN(i, N-1)]++;
+    }
+    void print(std::ostream& o) const {
+        o << '[';
+        for(int i=0, k=0; i<N; i++) {
+            if(count[i] == 0) continue;
+            o << (k++ ? ", [" : "[") << (1L<<i) << ", " << count[i] << ']';
+        }
+        o << ']';
+    }
+};
+
+static std::mutex lock;// for queue
+static std::condition_variable ready, space;
+static std::deque<request> queue;
+static size_t queue_size(1024);// max number of requests in queue
+static std::atomic<long> n_request(0), n_error(0), n_deadline(0), n_hit(0), n_miss(0);
+static histogram latency, solve_time;
+
+typedef std::map<std::vector<double>, std::list<BBN_table>::iterator> table_map;
+static std::mutex cache_lock;
+static std::list<BBN_table> cache;// most recently used first
+static table_map cache_index;
+static size_t cache_size(8);
+
+static bool use_table(const job& j, std::string& err)
+// set interpolation tables of calling thread for job j;
+// return false and set err if tables cannot be built
+{
+    static thread_local std::vector<double> current;// key of tables in thread
+    std::vector<double> key;
+    key.push_back(j.T_init);
+    key.push_back(j.T_final);
+    key.push_back(j.N_nu);
+    key.push_back(j.tier);
+    if(key == current) return true;
+    BBN::precision(BBN::tier[j.tier].name);
+    {
+        std::lock_guard<std::mutex> l(cache_lock);
+        table_map::iterator i(cache_index.find(key));
+        if(i != cache_index.end()) {
+            cache.splice(cache.begin(), cache, i->second);
+            BBN::load_table(cache.front());
+            current = key;
+            n_hit++;
+            return true;
+        }
+    }
+    n_miss++;
+    try { BBN::interp_init(j.T_init, j.T_final, j.N_nu); }
+    catch(const nr_error& e) {
+        current.clear();// tables of thread are incomplete
+        err = e.what();
+        return false;
+    }
+    std::lock_guard<std::mutex> l(cache_lock);
+    if(cache_index.find(key) == cache_index.end()) {
+        cache.push_front(BBN_table());
+        BBN::save_table(cache.front());
+        cache.front().tier = j.tier;
+        cache_index[key] = cache.begin();
+        while(cache.size() > cache_size) {
+            const BBN_table& a(cache.back());
+            double k[4] = { a.T_init, a.T_final, a.N_nu, double(a.tier) };
+            cache_index.erase(std::vector<double>(k, k+4));
+            cache.pop_back();
+        }
+    }
+    current = key;
+    return true;
+}
+
+static std::string statistics()
+{
+    std::ostringstream o;
+    o << "{\"requests\": " << n_request
+      << ", \"errors\": " << n_error
+      << ", \"deadline_exceeded\": " << n_deadline
+      << ", \"cache_hits\": " << n_hit
+      << ", \"cache_misses\": " << n_miss;
+    if(job_memo)
+        o << ", \"memo_hits\": " << job_memo->hits
+          << ", \"memo_misses\": " << job_memo->misses
+          << ", \"memo_evictions\": " << job_memo->evictions;
+    o << ", \"latency_us\": ";
+    latency.print(o);
+    o << ", \"solve_us\": ";
+    solve_time.print(o);
+    o << "}\n";
+    return o.str();
+}
+
+static void worker()
+{
+    std::string err;
+    job j;
+    job_result r;
+    for(;;) {
+        request q;
+        {
+            std::unique_lock<std::mutex> l(lock);
+            ready.wait(l, []{ return !queue.empty(); });
+            q = queue.front();
+            queue.pop_front();
+        }
+        space.notify_one();
+        if(q.line.compare(0, 5, "stats") == 0) {
+            q.conn->send(statistics());
+            continue;
+        }
+        n_request++;
+        double t0(solver_stats::clock()), deadline(0);
+        if(!j.parse(q.line, err)) { r.id = j.id; r.error = err; }
+        else {
+            if(j.deadline > 0) deadline = q.arrival + j.deadline*1e-3;
+            if(deadline && t0 > deadline) {
+                r.id = j.id;
+                r.error = "deadline exceeded";
+            }
+            else if(!recall_job(j, r)) {
+                if(use_table(j, err)) run_job(j, r, deadline);
+                else {
+                    r.id = j.id;
+                    r.error = err;
+                }
+            }
+        }
+        if(r.error.size()) {
+            n_error++;
+            if(r.error == "deadline exceeded") n_deadline++;
+        }
+        std::ostringstream o;
+        r.print(o);
+        q.conn->send(o.str());
+        double t1(solver_stats::clock());
+        solve_time.add(t1 - t0);
+        latency.add(t1 - q.arrival);
+    }
+}
+
+static void reader(std::shared_ptr<connection> conn)
+// read requests from connection and push them to queue
+{
+    char buf[4096];
+    std::string line;
+    ssize_t n,i;
+    while((n = read(conn->fd, buf, sizeof(buf))) > 0) {
+        for(i=0; i<n; i++) {
+            if(buf[i] != '\n') { line += buf[i]; continue; }
+            if(line.find_first_not_of(" \t\r") != std::string::npos) {
+                request q;
+                q.conn = conn;
+                q.line.swap(line);
+                q.arrival = solver_stats::clock();
+                std::unique_lock<std::mutex> l(lock);
+                space.wait(l, []{ return queue.size() < queue_size; });
+                queue.push_back(q);
+                ready.notify_one();
+            }
+            line.clear();
+        }
+    }
+}
+
+int main(int argc, char **argv) {
+    int i, n(std::thread::hardware_concurrency()), fd, cfd;
+    const char *path("/tmp/bbnd.sock"), *memo(0);
+    double memo_size(1024);
+    struct sockaddr_un addr;
+    for(i=1; i<argc; i++) {
+        if(strcmp(argv[i], "-j")==0 && i+1<argc) n = atoi(argv[++i]);
+        else if(strcmp(argv[i], "-c")==0 && i+1<argc) cache_size = atoi(argv[++i]);
+        else if(strcmp(argv[i], "-q")==0 && i+1<argc) queue_size = atoi(argv[++i]);
+        else if(strcmp(argv[i], "-m")==0 && i+1<argc) memo = argv[++i];
+        else if(strcmp(argv[i], "-M")==0 && i+1<argc) memo_size = atof(argv[++i]);
+        else path = argv[i];
+    }
+    if(n<1) n = 1;
+    // share cores among workers when tables are built
+    BBN::table_threads = MAX(1, int(std::thread::hardware_concurrency())/n);
+    if(cache_size<1) cache_size = 1;
+    if(queue_size<1) queue_size = 1;
+    if(memo) job_memo = new memo_store(memo, long(memo_size*(1<<20)));
+    signal(SIGPIPE, SIG_IGN);
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strncpy(addr.sun_path, path, sizeof(addr.sun_path)-1);
+    unlink(path);
+    if((fd = socket(AF_UNIX, SOCK_STREAM, 0)) < 0 ||
+       bind(fd, (struct sockaddr*)&addr, sizeof(addr)) ||
+       listen(fd, 64)) {
+        perror("bbnd");
+        return 1;
+    }
+    for(i=0; i<n; i++) std::thread(worker).detach();
+    while((cfd = accept(fd, 0, 0)) >= 0)
+        std::thread(reader, std::make_shared<connection>(cfd)).detach();
+    perror("bbnd");
+    return 1;
+}
@@ -0,0 +1,242 @@
+// sharded batch driver on worker processes: read jobs (one JSON object
+// per line, see job.h) from file or stdin, solve them on forked worker
+// processes and write results (one JSON object per line, as bbn) to
+// stdout in the order of input
+// usage: bbnp [-P procs] [-s shard] [-m dir [-M megabytes]] [file]
+//   -P procs: number of worker processes (default number of cores)
+//   -s shard: number of consecutive jobs claimed at once by a worker
+//             (default n_job/(4*procs), at least 1)
+//   -m dir: recall results from store in dir before fork, and save
+//           new results to it (see memo.h); statistics of recall are
+//           printed to stderr
+//   -M megabytes: max size of store (default 1024)
+// interpolation tables for each (T_init, T_final, N_nu, precision)
+// of jobs not recalled are made once before fork and shared by workers
+// (copy-on-write);
+// jobs are handed out in shards by compare-and-swap on shared memory,
+// and results are gathered in shared columnar buffer;
+// if a worker dies (e.g. it is killed or aborts), the job it was
+// solving is reported as error, and a new worker resumes unfinished
+// jobs of its shards (finished results are kept); errors of solver
+// (nr_error) are reported by run_job without killing the worker, and
+// passed to parent in shared memory with number of retries
+
+#include<cstdlib>
+#include<cstring>
+#include<fstream>
+#include<sstream>
+#include<atomic>
+#include<new>
+#include<thread>
+#include<unistd.h>
+#include<sys/mman.h>
+#include<sys/wait.h>
+#include "job.h"
+#include "memo.h"
+#include "BBN.h"
+
+enum { PENDING, DONE, FAILED };// state of job
+const int FREE(0), FINISHED(-1);// owner of shard (else worker+1)
+
+// shared memory
+static std::atomic<int> *next;// next shard to be claimed
+static std::atomic<int> *owner;// owner of shard
+static std::atomic<int> *state;// state of job
+static std::atomic<int> *running;// job solved by worker (-1 if none)
+static int *status;// wait status of worker died in job
+static int *retries;// number of retries of job (see BBN::retry)
+static char *message;// error of job (MESSAGE_SIZE chars per job)
+const int MESSAGE_SIZE(256);
+static double *X;// X[k*n_job + j] = column k of job j (k=0: wall time)
+
+static std::vector<job> J;// jobs
+static std::vector<std::string> error;// errors of parsing
+static std::vector<BBN_table> table;// tables made before fork
+static int n_job, n_shard, shard;
+
+static size_t find_table(const job& a)
+// return index of table for job a (table.size() if not found)
+{
+    size_t i;
+    for(i=0; i<table.size(); i++) {
+        const BBN_table& b(table[i]);
+        if(b.tier == a.tier && b.T_init == a.T_init
+           && b.T_final == a.T_final && b.N_nu == a.N_nu) break;
+    }
+    return i;
+}
+
+static bool take(int s, int w)
+// claim shard s for worker w if it is free
+{
+    int f(FREE);
+    return owner[s].compare_exchange_strong(f, w+1);
+}
+
+static int claim(int w)
+// return index of shard claimed by worker w (-1 if none is left)
+{
+    int s;
+    while((s = (*next)++) < n_shard)
+        if(take(s, w)) return s;
+    // shards released by died workers
+    for(s=0; s<n_shard; s++)
+        if(take(s, w)) return s;
+    return -1;
+}
+
+static void worker(int w)
+{
+    int j,s;
+    size_t i,k,t(table.size());
+    job_result r;
+    BBN::table_threads = 1;
+    while((s = claim(w)) >= 0) {
+        for(j=s*shard; j<MIN(n_job, (s+1)*shard); j++) {
+            if(state[j] != PENDING) continue;
+            running[w] = j;
+            const job& a(J[j]);
+            BBN::precision(BBN::tier[a.tier].name);
+            if((i = find_table(a)) != t) BBN::load_table(table[t = i]);
+            run_job(a, r);
+            X[j] = r.wall;
+            retries[j] = r.retries;
+            if(r.error.size()) {
+                strncpy(message + j*MESSAGE_SIZE, r.error.c_str(), MESSAGE_SIZE-1);
+                state[j] = FAILED;
+                continue;
+            }
+            for(k=0; k<r.X.size(); k++) X[(k+1)*n_job + j] = r.X[k];
+            state[j] = DONE;
+        }
+        running[w] = -1;
+        owner[s] = FINISHED;
+    }
+    _exit(0);
+}
+
+static pid_t start(int w)
+// fork worker w
+{
+    std::cout.flush();
+    std::cerr.flush();
+    pid_t p(fork());
+    if(p == 0) worker(w);
+    if(p < 0) perror("fork");
+    return p;
+}
+
+int main(int argc, char **argv) {
+    int i,j,k,w,n(std::thread::hardware_concurrency()),width(0),restart(0);
+    std::ifstream f;
+    std::istream *in(&std::cin);
+    std::string line, err;
+    const char *memo(0);
+    double memo_size(1024);
+    job a;
+    job_result r;
+    for(i=1; i<argc; i++) {
+        if(strcmp(argv[i], "-P")==0 && i+1<argc) n = atoi(argv[++i]);
+        else if(strcmp(argv[i], "-s")==0 && i+1<argc) shard = atoi(argv[++i]);
+        else if(strcmp(argv[i], "-m")==0 && i+1<argc) memo = argv[++i];
+        else if(strcmp(argv[i], "-M")==0 && i+1<argc) memo_size = atof(argv[++i]);
+        else if(strcmp(argv[i], "-")) {
+            f.open(argv[i]);
+            if(!f) { std::cerr << "cannot read " << argv[i] << '\n'; return 1; }
+            in = &f;
+        }
+    }
+    if(n<1) n = 1;
+    if(memo) job_memo = new memo_store(memo, long(memo_size*(1<<20)));
+    while(std::getline(*in, line)) {
+        if(line.find_first_not_of(" \t\r") == std::string::npos) continue;
+        if(!a.parse(line, err)) a.T.clear();
+        else err.clear();
+        J.push_back(a);
+        error.push_back(err);
+        width = MAX(width, int(a.T.size()*BBN::N_element));
+    }
+    if((n_job = J.size()) == 0) return 0;
+    if(shard < 1) shard = MAX(1, n_job/(4*n));
+    n_shard = (n_job + shard - 1)/shard;
+    // control block and results in shared memory
+    size_t m(sizeof(std::atomic<int>)*(1 + n_shard + n_job + n)
+             + 2*sizeof(int)*n_job + sizeof(double)*(width+1)*n_job
+             + MESSAGE_SIZE*size_t(n_job));
+    void *p(mmap(0, m, PROT_READ | PROT_WRITE,
+                 MAP_SHARED | MAP_ANONYMOUS, -1, 0));
+    if(p == MAP_FAILED) { perror("mmap"); return 1; }
+    X = (double*)p;// aligned at page
+    next = new((char*)p + sizeof(double)*(width+1)*n_job) std::atomic<int>(0);
+    owner = next + 1;
+    state = owner + n_shard;
+    running = state + n_job;
+    status = (int*)(running + n);
+    retries = status + n_job;
+    message = (char*)(retries + n_job);// zero filled by mmap
+    for(i=0; i<n_shard; i++) new(owner + i) std::atomic<int>(FREE);
+    for(j=0; j<n_job; j++)
+        new(state + j) std::atomic<int>(error[j].size() ? FAILED : PENDING);
+    for(w=0; w<n; w++) new(running + w) std::atomic<int>(-1);
+    for(j=0; j<n_job; j++) {
+        const job& a(J[j]);
+        if(state[j] != PENDING) continue;
+        if(recall_job(a, r)) {
+            X[j] = r.wall;
+            for(i=0; i<int(r.X.size()); i++) X[(i+1)*n_job + j] = r.X[i];
+            state[j] = DONE;
+        }
+        else if(find_table(a) == table.size()) {
+            BBN::precision(BBN::tier[a.tier].name);
+            BBN::interp_init(a.T_init, a.T_final, a.N_nu);
+            table.push_back(BBN_table());
+            BBN::save_table(table.back());
+            table.back().tier = a.tier;
+        }
+    }
+    std::vector<pid_t> pid(n);
+    for(w=0; w<n; w++) pid[w] = start(w);
+    for(k=n; k>0;) {
+        int s;
+        pid_t q(wait(&s));
+        if(q < 0) break;
+        for(w=0; w<n && pid[w] != q; w++);
+        if(w == n) continue;
+        k--;
+        if(WIFEXITED(s) && WEXITSTATUS(s) == 0) continue;
+        if((j = running[w]) >= 0) { status[j] = s; state[j] = FAILED; }
+        running[w] = -1;
+        for(i=0; i<n_shard; i++)
+            if(owner[i] == w+1) owner[i] = FREE;
+        if(restart++ > n_job) continue;// failed before any job
+        if((pid[w] = start(w)) > 0) k++;
+    }
+    for(j=0; j<n_job; j++) {
+        r.id = J[j].id;
+        r.T = J[j].T;
+        r.X.resize(r.T.size()*BBN::N_element);
+        r.error = error[j];
+        r.retries = retries[j];
+        if(state[j] == FAILED && message[j*MESSAGE_SIZE])
+            r.error = message + j*MESSAGE_SIZE;
+        if(state[j] == DONE) {
+            r.wall = X[j];
+            for(i=0; i<int(r.X.size()); i++) r.X[i] = X[(i+1)*n_job + j];
+        }
+        else if(r.error.empty()) {
+            std::ostringstream e;
+            int s(status[j]);
+            if(state[j] == PENDING) e << "not solved";
+            else if(WIFSIGNALED(s)) e << "worker killed by signal " << WTERMSIG(s);
+            else e << "worker exited with status " << WEXITSTATUS(s);
+            r.error = e.str();
+        }
+        r.print(std::cout);
+    }
+    if(restart) std::cerr << restart << " workers restarted\n";
+    if(job_memo)
+        std::cerr << "memo " << memo << ": hits " << job_memo->hits
+                  << ", misses " << job_memo->misses << '\n';
+    munmap(p, m);
+    return 0;
+}
@@ -0,0 +1,38 @@
+// client of bbnd for testing: send lines of stdin as requests
+// and print responses until all of them are answered
+// usage: bbnq [socket]  (default /tmp/bbnd.sock)
+
+#include<cstdio>
+#include<cstring>
+#include<string>
+#include<iostream>
+#include<unistd.h>
+#include<sys/socket.h>
+#include<sys/un.h>
+
+int main(int argc, char **argv) {
+    int fd;
+    const char *path(argc>1 ? argv[1] : "/tmp/bbnd.sock");
+    struct sockaddr_un addr;
+    std::string line, all;
+    char buf[4096];
+    ssize_t n;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strncpy(addr.sun_path, path, sizeof(addr.sun_path)-1);
+    if((fd = socket(AF_UNIX, SOCK_STREAM, 0)) < 0 ||
+       connect(fd, (struct sockaddr*)&addr, sizeof(addr))) {
+        perror("bbnq");
+        return 1;
+    }
+    while(std::getline(std::cin, line)) all += line + '\n';
+    for(size_t k(0); k < all.size(); k += n)
+        if((n = write(fd, all.data()+k, all.size()-k)) <= 0) {
+            perror("bbnq");
+            return 1;
+        }
+    shutdown(fd, SHUT_WR);// server closes after answering all
+    while((n = read(fd, buf, sizeof(buf))) > 0) fwrite(buf, 1, n, stdout);
+    close(fd);
+    return 0;
+}
@@ -0,0 +1,233 @@
+// microbenchmarks of hot kernels
+// usage: bench [output.json [repeat]]
+// each kernel is warmed up (also to raise cpu clock), then timed in
+// batches of calls calibrated to last about 10 msec; statistics over
+// batches are printed and written to output.json (default bench.json)
+// with compiler flags; "make bench" builds without optimization, as
+// other targets, and "make bench-O2" builds all sources with -O2
+
+#include<cmath>
+#include<cstdio>
+#include<cstdlib>
+#include<cstring>
+#include<chrono>
+#include<vector>
+#include<string>
+#include<algorithm>
+#include<fstream>
+#include<sched.h>
+#include<unistd.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include<x86intrin.h>
+#define CYCLES() __rdtsc()
+#else
+#define CYCLES() 0ULL
+#endif
+#include "observer.h"
+#include "BBN.h"
+
+void expansion_eq(double, const Vec_DP&, Vec_DP&);
+void ludcmp(Mat_DP &a, Vec_INT &indx, double &d);
+void lubksb(const Mat_DP &a, const Vec_INT &indx, Vec_DP &b);
+void elmhes(Mat_DP &a, Vec_INT &perm, Vec_DP &scale);
+void hesdcmp(const Mat_DP &h, const double s, Mat_DP &b, Vec_INT &piv);
+void hesbksb(const Mat_DP &h, const Vec_INT &perm, const Vec_DP &scale,
+             const Mat_DP &b, const Vec_INT &piv, Vec_DP &x);
+extern thread_local void (*jacobn_s)(double, const Vec_DP&, Vec_DP&, Mat_DP&);
+
+#ifndef BENCH_FLAGS// compiler flags stated in output
+#ifdef __OPTIMIZE__
+#define BENCH_FLAGS "-O (level unknown)"
+#else
+#define BENCH_FLAGS "-O0"
+#endif
+#endif
+
+static double WARMUP(0.2);// warm-up time / sec
+static double BATCH(0.01);// time of one batch / sec
+static int REPEAT(15);// number of batches
+volatile double sink;// prevent elimination of kernels
+
+struct result {
+    std::string name;
+    long calls;// number of calls per batch
+    double ns, ns_sd, ns_min, ns_median;// nsec per call
+    double cyc, cyc_sd;// cycles per call
+};
+
+static std::vector<result> results;
+
+static double now()
+{
+    return std::chrono::duration<double>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+template<class F>
+void measure(const char *name, F f)
+// time kernel f() and append statistics to results
+{
+    int i;
+    long n,k;
+    double t,s,s2,q,q2;
+    unsigned long long c0;
+    std::vector<double> ns(REPEAT), cyc(REPEAT);
+    result r;
+    // warm up and calibrate batch size
+    t = now();
+    for(n=0; now()-t < WARMUP; n++) f();
+    n = MAX(1L, long(n*BATCH/WARMUP));
+    for(i=0; i<REPEAT; i++) {
+        c0 = CYCLES();
+        t = now();
+        for(k=0; k<n; k++) f();
+        t = now() - t;
+        cyc[i] = double(CYCLES() - c0)/n;
+        ns[i] = t*1e9/n;
+    }
+    for(s=s2=q=q2=i=0; i<REPEAT; i++) {
+        s += ns[i]; s2 += ns[i]*ns[i];
+        q += cyc[i]; q2 += cyc[i]*cyc[i];
+    }
+    r.name = name;
+    r.calls = n;
+    r.ns = s/REPEAT;
+    r.ns_sd = sqrt(MAX(0., s2/REPEAT - r.ns*r.ns));
+    r.cyc = q/REPEAT;
+    r.cyc_sd = sqrt(MAX(0., q2/REPEAT - r.cyc*r.cyc));
+    std::sort(ns.begin(), ns.end());
+    r.ns_min = ns[0];
+    r.ns_median = ns[REPEAT/2];
+    results.push_back(r);
+    printf("%-24s %12.1f ns (+-%5.1f%%) %12.0f cycles\n",
+           name, r.ns_median, 100*r.ns_sd/r.ns, r.cyc);
+    fflush(stdout);
+}
+
+static std::string governor()
+// cpu frequency governor of cpu 0 (empty if unknown)
+{
+    std::ifstream f("/sys/devices/system/cpu/cpu0/cpufreq/scaling_governor");
+    std::string s;
+    f >> s;
+    return s;
+}
+
+int main(int argc, char **argv) try {
+    const char *fname(argc>1 ? argv[1] : "bench.json");
+    int i,n(BBN::N_element);
+    double T(1), t, T_nu, p_n, n_p, d, h, hdid, hnext, x;
+    std::string gov(governor());
+    if(argc>2) REPEAT = MAX(3, atoi(argv[2]));
+
+    // pin to one cpu to avoid migration
+    cpu_set_t cpu;
+    CPU_ZERO(&cpu);
+    CPU_SET(sched_getcpu(), &cpu);
+    sched_setaffinity(0, sizeof(cpu), &cpu);
+    if(gov.size() && gov != "performance")
+        fprintf(stderr, "warning: cpu frequency governor is %s\n", gov.c_str());
+    printf("compiled with %s\n", BENCH_FLAGS);
+    BBN::retry.n = 0;// kernels are timed as labeled (failure is error)
+
+    BBN::init(5e-10, 10, 0.01);
+    if(BBN::set_temperature(T)) nrerror(BBN::error.c_str());// state at T=1MeV
+    t = BBN::expansion_time(T);
+    T_nu = BBN::neutrino_temperature(T);
+    Vec_DP r(BBN::N_reaction), r2(BBN::N_reaction), y(BBN::y);
+    Vec_DP f(n), fx(n), yy(n), dydx(n), yscal(n), e(2), ye(2);
+    Vec_INT indx(n);
+    Mat_DP fy(n,n), a(n,n);
+    ye[0] = 0; ye[1] = T_nu;
+
+    measure("reaction_rate(r,T)", [&]{ BBN::reaction_rate(r, T); sink = r[0]; });
+    measure("reaction_rate(r1,r2,T)", [&]{ BBN::reaction_rate(r, r2, T); sink = r2[0]; });
+    measure("expansion_eq", [&]{ expansion_eq(T, ye, e); sink = e[0]; });
+    measure("weak_rate", [&]{ weak_rate(p_n, n_p, T, T_nu); sink = p_n; });
+    measure("splint", [&]{ sink = BBN::temperature(t); });
+    measure("diff_eq", [&]{ BBN::diff_eq(t, y, f); sink = f[0]; });
+    measure("jac", [&]{ BBN::jac(t, y, fx, fy); sink = fy[0][0]; });
+    h = 1e-2*t;
+    Mat_DP J(fy), H(n,n), B(n,n);
+    Vec_INT perm(n);
+    Vec_DP scale(1.,n);
+    for(i=0; i<n*n; i++) fy[i/n][i%n] = -h*fy[i/n][i%n] + (i/n==i%n);
+    measure("ludcmp", [&]{ a = fy; ludcmp(a, indx, d); sink = a[0][0]; });
+    measure("lubksb", [&]{ yy = y; lubksb(a, indx, yy); sink = yy[0]; });
+    measure("elmhes", [&]{ H = J; elmhes(H, perm, scale); sink = H[0][0]; });
+    measure("hesdcmp", [&]{ hesdcmp(H, h, B, indx); sink = B[0][0]; });
+    measure("hesbksb", [&]{ yy = y; hesbksb(H, perm, scale, B, indx, yy); sink = yy[0]; });
+
+    BBN::diff_eq(t, y, dydx);
+    for(i=0; i<n; i++) yscal[i] = fabs(y[i]) + fabs(dydx[i]*h) + 1e-30;
+    jacobn_s = BBN::jac;
+    for(int s=LU_SOLVER; s<=HESSENBERG_SOLVER; s++) {
+        linear_solver = s;
+        measure(s ? "stifbs step (hessenberg)" : "stifbs step", [&]{
+            yy = y; x = t;
+            stifbs(yy, dydx, x, h, 1e-6, yscal, hdid, hnext, BBN::diff_eq);
+            sink = yy[0];
+        });
+    }
+    linear_solver = LU_SOLVER;
+
+    WARMUP = 1; BATCH = 1; REPEAT = MIN(REPEAT, 5);
+    for(int l=0; l<2; l++) {
+        BBN::log_abundance = l;
+        measure(l ? "fig5-6 integration (log)" : "fig5-6 integration", [&]{
+            BBN::init(5e-10, 10, 0.01);
+            for(i=0; i<=256; i++)
+                if(BBN::set_temperature(10*pow(1e-3, i/256.))) nrerror(BBN::error.c_str());
+            sink = BBN::y[0];
+        });
+        measure(l ? "fig7 point (log)" : "fig7 point", [&]{
+            BBN::init(1e-9, 10, 0.01);
+            if(BBN::set_temperature(0.01)) nrerror(BBN::error.c_str());
+            sink = BBN::y[0];
+        });
+    }
+    BBN::log_abundance = false;
+    decimating_recorder rec(4096);
+    measure("fig7 point (observer)", [&]{// full trajectory
+        rec.clear();
+        BBN::observer = &rec;
+        BBN::init(1e-9, 10, 0.01);
+        if(BBN::set_temperature(0.01)) nrerror(BBN::error.c_str());
+        BBN::observer = 0;
+        if(rec.n) sink = rec.record(rec.n-1)[2];
+    });
+    linear_solver = HESSENBERG_SOLVER;
+    measure("fig7 point (hessenberg)", [&]{
+        BBN::init(1e-9, 10, 0.01);
+        if(BBN::set_temperature(0.01)) nrerror(BBN::error.c_str());
+        sink = BBN::y[0];
+    });
+    linear_solver = LU_SOLVER;
+    BBN::qss_ratio = 1e4;
+    measure("fig7 point (qss)", [&]{
+        BBN::init(1e-9, 10, 0.01);
+        if(BBN::set_temperature(0.01)) nrerror(BBN::error.c_str());
+        sink = BBN::y[0];
+    });
+    BBN::qss_ratio = 0;
+
+    FILE *fp(fopen(fname, "w"));
+    if(fp==0) nrerror("cannot write benchmark results");
+    fprintf(fp, "{\"governor\": \"%s\", \"flags\": \"%s\", \"results\": [\n",
+            gov.c_str(), BENCH_FLAGS);
+    for(i=0; i<int(results.size()); i++) {
+        result& q(results[i]);
+        fprintf(fp, "  {\"name\": \"%s\", \"calls\": %ld, \"ns\": %.6g, "
+                "\"ns_sd\": %.6g, \"ns_min\": %.6g, \"ns_median\": %.6g, "
+                "\"cycles\": %.6g, \"cycles_sd\": %.6g}%s\n",
+                q.name.c_str(), q.calls, q.ns, q.ns_sd, q.ns_min, q.ns_median,
+                q.cyc, q.cyc_sd, i+1<int(results.size()) ? "," : "");
+    }
+    fprintf(fp, "]}\n");
+    fclose(fp);
+    return 0;
+}
+catch(const nr_error& e) {
+    fprintf(stderr, "bench: %s\n", e.what());
+    return 1;
+}
@@ -0,0 +1,304 @@
+// columnar binary format for tables of doubles (see column.h)
+
+#include<cstring>
+#include<fcntl.h>
+#include<unistd.h>
+#include<sys/mman.h>
+#include<sys/stat.h>
+#include "column.h"
+
+static void copy_name(char *dst, const char *src, int n)
+{ strncpy(dst, src, n-1); dst[n-1] = 0; }
+
+static size_t pad8(size_t n) { return (n+7)&~size_t(7); }
+
+void column_encode(const double *x, int n, std::vector<unsigned char>& out)
+// xor with previous value, shuffle bytes and run-length encode
+// input: x = array of length n
+// output: out = encoded bytes
+{
+    int i,j,k,m(8*n);
+    unsigned long long u,v(0);
+    std::vector<unsigned char> b(m);
+    for(i=0; i<n; i++) {// xor and byte-shuffle
+        memcpy(&u, x+i, 8);
+        v ^= u;
+        for(j=0; j<8; j++) b[j*n + i] = (v >> (8*j)) & 0xff;
+        v = u;
+    }
+    out.clear();
+    for(i=0; i<m; i=j) {// run-length (PackBits)
+        for(j=i+1; j<m && j-i<129 && b[j]==b[i]; j++);
+        if(j-i >= 2) {
+            out.push_back(j-i+126);
+            out.push_back(b[i]);
+            continue;
+        }
+        for(j=i+1; j<m && j-i<128; j++)
+            if(j+1<m && b[j]==b[j+1]) break;
+        out.push_back(j-i-1);
+        for(k=i; k<j; k++) out.push_back(b[k]);
+    }
+}
+
+void column_decode(const unsigned char *in, size_t m, double *x, int n)
+// inverse of column_encode
+// input: in = encoded bytes of length m
+// output: x = array of length n
+{
+    int i,j,k;
+    size_t l;
+    unsigned long long u,v(0);
+    std::vector<unsigned char> b(8*n);
+    for(l=k=0; l<m && k<8*n;) {
+        if(in[l] < 128) {
+            for(j=in[l++]+1; j>0 && k<8*n; j--) b[k++] = in[l++];
+        }
+        else {
+            for(j=in[l++]-126; j>0 && k<8*n; j--) b[k++] = in[l];
+            l++;
+        }
+    }
+    for(i=0; i<n; i++) {
+        for(u=j=0; j<8; j++) u |= (unsigned long long)b[j*n + i] << (8*j);
+        v ^= u;
+        memcpy(x+i, &v, 8);
+    }
+}
+
+column_writer::column_writer(int chunk_rows_)
+: fp(0), chunk_rows(chunk_rows_), n_row(0), failed(false) {;}
+
+column_writer::~column_writer() { close(); }
+
+void column_writer::column(const char *name, const char *unit, int codec)
+// add column (before open)
+{
+    column_info c;
+    memset(&c, 0, sizeof(c));
+    copy_name(c.name, name, sizeof(c.name));
+    copy_name(c.unit, unit, sizeof(c.unit));
+    c.codec = codec;
+    info.push_back(c);
+}
+
+void column_writer::parameter(const char *name, double value, const char *unit)
+// add parameter (before open)
+{
+    column_param p;
+    memset(&p, 0, sizeof(p));
+    copy_name(p.name, name, sizeof(p.name));
+    copy_name(p.unit, unit, sizeof(p.unit));
+    p.value = value;
+    param.push_back(p);
+}
+
+bool column_writer::open(const char *fname)
+// create file and write header; return false if failed
+{
+    column_header h;
+    close();
+    if((fp = fopen(fname, "wb")) == 0) return false;
+    memcpy(h.magic, COLUMN_MAGIC, 4);
+    h.version = COLUMN_VERSION;
+    h.n_col = info.size();
+    h.n_param = param.size();
+    failed = (fwrite(&h, sizeof(h), 1, fp) != 1 ||
+              fwrite(info.data(), sizeof(column_info), info.size(), fp) != info.size() ||
+              fwrite(param.data(), sizeof(column_param), param.size(), fp) != param.size());
+    buf.resize(info.size()*chunk_rows);
+    n_row = 0;
+    if(failed) { fclose(fp); fp = 0; }
+    return !failed;
+}
+
+bool column_writer::append(const char *fname)
+// open existing file to append chunks, or create it if absent;
+// columns must be the same as those in the file;
+// trailing partial chunk (e.g. by crash of writer) is truncated
+{
+    column_reader r;
+    close();
+    if(access(fname, F_OK)) return open(fname);
+    if(!r.open(fname) || r.info.size() != info.size()) return false;
+    for(size_t j=0; j<info.size(); j++)
+        if(strcmp(r.info[j].name, info[j].name) || r.info[j].codec != info[j].codec)
+            return false;
+    size_t end(r.n_byte());
+    r.close();
+    if((fp = fopen(fname, "r+b")) == 0) return false;
+    if(ftruncate(fileno(fp), end) || fseek(fp, end, SEEK_SET))
+    { fclose(fp); fp = 0; return false; }
+    buf.resize(info.size()*chunk_rows);
+    n_row = 0;
+    failed = false;
+    return true;
+}
+
+void column_writer::write(const double *row)
+// append one row (array of length n_col)
+{
+    for(size_t j=0; j<info.size(); j++)
+        buf[j*chunk_rows + n_row] = row[j];
+    if(++n_row == chunk_rows) flush();
+}
+
+bool column_writer::flush()
+// write buffered rows as one chunk;
+// return false if any write to file has failed
+{
+    static const char zero[8] = {0};
+    column_chunk h;
+    size_t j, n(info.size());
+    std::vector<long long> size(n);
+    std::vector<std::vector<unsigned char> > enc(n);
+    if(fp==0 || n_row==0) return !failed;
+    memcpy(h.magic, COLUMN_CHUNK, 4);
+    h.n_row = n_row;
+    for(j=0; j<n; j++) {
+        if(info[j].codec == COLUMN_XOR_RLE) {
+            column_encode(&buf[j*chunk_rows], n_row, enc[j]);
+            size[j] = enc[j].size();
+        }
+        else size[j] = 8*n_row;
+    }
+    if(fwrite(&h, sizeof(h), 1, fp) != 1 ||
+       fwrite(&size[0], sizeof(long long), n, fp) != n) failed = true;
+    for(j=0; j<n && !failed; j++) {
+        size_t m(pad8(size[j]) - size[j]);
+        if(info[j].codec == COLUMN_XOR_RLE)
+            failed = (fwrite(&enc[j][0], 1, size[j], fp) != size_t(size[j]));
+        else
+            failed = (fwrite(&buf[j*chunk_rows], 8, n_row, fp) != size_t(n_row));
+        if(m && fwrite(zero, 1, m, fp) != m) failed = true;
+    }
+    n_row = 0;
+    return !failed;
+}
+
+bool column_writer::close()
+// flush and close file; return false if any write has failed
+{
+    if(fp==0) return !failed;
+    flush();
+    if(fclose(fp)) failed = true;
+    fp = 0;
+    return !failed;
+}
+
+column_reader::column_reader() : map(0), size(0), end(0) {;}
+
+column_reader::~column_reader() { close(); }
+
+bool column_reader::open(const char *fname)
+// map file into memory and index chunks; return false if failed
+// (or if header is invalid); chunks are read up to first incomplete
+// or invalid one
+{
+    int fd;
+    struct stat st;
+    size_t p,q,j;
+    column_header h;
+    column_chunk c;
+    close();
+    if((fd = ::open(fname, O_RDONLY)) < 0) return false;
+    if(fstat(fd, &st) || st.st_size < long(sizeof(h))) { ::close(fd); return false; }
+    size = st.st_size;
+    map = (const unsigned char*)mmap(0, size, PROT_READ, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if(map == MAP_FAILED) { map = 0; return false; }
+    memcpy(&h, map, sizeof(h));
+    if(strncmp(h.magic, COLUMN_MAGIC, 4) || h.version != COLUMN_VERSION
+       || h.n_col < 0 || h.n_param < 0
+       || size_t(h.n_col) > size || size_t(h.n_param) > size)
+    { close(); return false; }
+    p = sizeof(h) + h.n_col*sizeof(column_info) + h.n_param*sizeof(column_param);
+    if(p > size) { close(); return false; }
+    info.resize(h.n_col);
+    param.resize(h.n_param);
+    memcpy(info.data(), map + sizeof(h), h.n_col*sizeof(column_info));
+    if(h.n_param)
+        memcpy(&param[0], map + sizeof(h) + h.n_col*sizeof(column_info),
+               h.n_param*sizeof(column_param));
+    for(j=0; j<info.size(); j++)
+        if(info[j].codec != COLUMN_RAW && info[j].codec != COLUMN_XOR_RLE)
+        { close(); return false; }
+    for(end=p; p + sizeof(c) + 8*info.size() <= size; end=p) {
+        chunk_info k;
+        const long long *s((const long long*)(map + p + sizeof(c)));
+        memcpy(&c, map + p, sizeof(c));
+        if(strncmp(c.magic, COLUMN_CHUNK, 4) || c.n_row <= 0) break;
+        k.n_row = c.n_row;
+        k.block = map + p + sizeof(c) + 8*info.size();
+        for(q=k.block-map, j=0; j<info.size(); j++) {
+            if(q > size || s[j] < 0 || size_t(s[j]) > size - q) break;// bad size
+            if(info[j].codec == COLUMN_RAW && s[j] != 8LL*c.n_row) break;
+            q += pad8(s[j]);
+        }
+        if(j < info.size() || q > size) break;// incomplete chunk
+        chunk.push_back(k);
+        p = q;
+    }
+    return true;
+}
+
+void column_reader::close()
+{
+    if(map) munmap((void*)map, size);
+    map = 0;
+    size = end = 0;
+    info.clear();
+    param.clear();
+    chunk.clear();
+}
+
+long column_reader::n_row() const
+// total number of rows
+{
+    long n(0);
+    for(size_t k=0; k<chunk.size(); k++) n += chunk[k].n_row;
+    return n;
+}
+
+int column_reader::find(const char *name) const
+// index of column by name (-1 if absent)
+{
+    for(size_t j=0; j<info.size(); j++)
+        if(strcmp(info[j].name, name)==0) return j;
+    return -1;
+}
+
+double column_reader::parameter(const char *name) const
+// value of parameter by name (0 if absent)
+{
+    for(size_t j=0; j<param.size(); j++)
+        if(strcmp(param[j].name, name)==0) return param[j].value;
+    return 0;
+}
+
+const double *column_reader::data(int k, int j, std::vector<double>& tmp) const
+// input: k = chunk index, j = column index
+// return: pointer to n_row(k) values of column j in chunk k,
+//   which points into mapped file if not compressed (no copy),
+//   else to tmp after decoding
+{
+    const chunk_info& c(chunk[k]);
+    const long long *s((const long long*)(c.block - 8*info.size()));
+    const unsigned char *b(c.block);
+    for(int i=0; i<j; i++) b += pad8(s[i]);
+    if(info[j].codec == COLUMN_RAW) return (const double*)b;
+    tmp.resize(c.n_row);
+    column_decode(b, s[j], &tmp[0], c.n_row);
+    return &tmp[0];
+}
+
+void column_reader::read(int j, double *x) const
+// gather all rows of column j into x
+{
+    std::vector<double> tmp;
+    for(size_t k=0; k<chunk.size(); k++) {
+        const double *d(data(k, j, tmp));
+        memcpy(x, d, 8*chunk[k].n_row);
+        x += chunk[k].n_row;
+    }
+}
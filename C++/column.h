@@ -0,0 +1,102 @@
+// columnar binary format for tables of doubles
+//
+// file layout (native little endian, every block 8-byte aligned):
+//   header:  column_header
+//            column_info[n_col]
+//            column_param[n_param]
+//   chunk:   column_chunk
+//            int64 size[n_col] (bytes of each column block)
+//            column block [n_col] (padded to multiple of 8 bytes)
+//   chunk ... (appended until end of file)
+// column block is raw float64 array of n_row elements if codec==0,
+// so that it can be read by numpy.frombuffer or mmap without copy;
+// if codec==1, values are xor-ed with previous one, byte-shuffled
+// and run-length encoded (good for smooth or repeated data).
+
+#ifndef __column_h__
+#define __column_h__
+
+#include<cstdio>
+#include<vector>
+#include<string>
+
+#define COLUMN_MAGIC "BBNC"
+#define COLUMN_CHUNK "CHNK"
+#define COLUMN_VERSION 1
+#define COLUMN_RAW 0// no compression
+#define COLUMN_XOR_RLE 1// xor, byte-shuffle and run-length encoding
+
+struct column_header {
+    char magic[4];
+    int version;
+    int n_col;// number of columns
+    int n_param;// number of parameters
+};
+
+struct column_info {
+    char name[32];
+    char unit[16];
+    int codec;// COLUMN_RAW or COLUMN_XOR_RLE
+    int pad;
+};
+
+struct column_param {
+    char name[32];
+    char unit[16];
+    double value;
+};
+
+struct column_chunk {
+    char magic[4];
+    int n_row;// number of rows in this chunk
+};
+
+struct column_writer {
+    std::vector<column_info> info;
+    std::vector<column_param> param;
+    column_writer(int chunk_rows=4096);
+    ~column_writer();
+    void column(const char *name, const char *unit="", int codec=COLUMN_RAW);
+    void parameter(const char *name, double value, const char *unit="");
+    bool open(const char *fname);
+    bool append(const char *fname);
+    void write(const double *row);
+    bool flush();
+    bool close();
+private:
+    FILE *fp;
+    int chunk_rows, n_row;
+    bool failed;// if write to file failed (reported by flush and close)
+    std::vector<double> buf;// buf[j*chunk_rows + i] = (row i, column j)
+};
+
+struct column_reader {
+    std::vector<column_info> info;
+    std::vector<column_param> param;
+    column_reader();
+    ~column_reader();
+    bool open(const char *fname);
+    void close();
+    int n_col() const { return info.size(); }
+    size_t n_byte() const { return end; }// size up to last complete chunk
+    int n_chunk() const { return chunk.size(); }
+    long n_row() const;
+    int n_row(int k) const { return chunk[k].n_row; }
+    int find(const char *name) const;
+    double parameter(const char *name) const;
+    const double *data(int k, int j, std::vector<double>& tmp) const;
+    void read(int j, double *x) const;
+private:
+    struct chunk_info {
+        int n_row;
+        const unsigned char *block;// pointer to first column block
+    };
+    const unsigned char *map;// memory mapped file
+    size_t size, end;
+    std::vector<chunk_info> chunk;
+};
+
+void column_encode(const double *x, int n, std::vector<unsigned char>& out);
+void column_decode(const unsigned char *in, size_t m, double *x, int n);
+
+#endif // __column_h__
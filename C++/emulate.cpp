@@ -0,0 +1,135 @@
+// build chebyshev emulator of final mass fractions by driving BBN solver
+// usage: emulate file [eta0 eta1 N_nu0 N_nu1 tau0 tau1 [n_eta n_N n_tau [n_test]]]
+// reference:
+//   W. H. Press, et al, "Numerical Recipes" section 5.8
+
+#include<cmath>
+#include<cstdlib>
+#include<chrono>
+#include "emulator.h"
+#include "BBN.h"
+
+static double T0(10), T1(0.01);// temperature range / MeV
+
+static void solve(double *Y, double eta, double N_nu, double tau)
+// Y[j] = log10 of mass fraction of element j at T=T1
+{
+    BBN::init(eta, T0, T1, N_nu, tau);
+    if(BBN::set_temperature(T1)) nrerror(BBN::error.c_str());
+    for(int j=0; j<BBN::N_element; j++)
+        Y[j] = log10(MAX(BBN::mass_fraction(j), 1e-300));
+}
+
+static void chebft(std::vector<double>& f, int m, int n, int l)
+// chebyshev transform of f along axis of length n,
+// where f is regarded as array of shape (m,n,l)
+{
+    int i,j,k,q;
+    double s;
+    std::vector<double> g(n);
+    for(i=0; i<m; i++) {
+        for(q=0; q<l; q++) {
+            double *p(&f[i*n*l + q]);
+            for(j=0; j<n; j++) {
+                for(s=k=0; k<n; k++)
+                    s += p[k*l]*cos(PI*j*(k+0.5)/n);
+                g[j] = s*(j ? 2. : 1.)/n;
+            }
+            for(j=0; j<n; j++) p[j*l] = g[j];
+        }
+    }
+}
+
+int main(int argc, char **argv) try {
+    int i,j,k,d,i0,i1,i2,n_test(20),N;
+    double lo[3] = { log10(1e-10), 2, 870 };
+    double hi[3] = { log10(1e-9), 4, 900 };
+    int n[3] = { 12, 5, 5 };
+    double x[3][EMULATOR_NMAX], p[3], err, maxerr(0);
+    volatile double sink;
+    emulator e;
+
+    if(argc<2) {
+        std::cerr << "usage: emulate file [eta0 eta1 N_nu0 N_nu1 tau0 tau1"
+                     " [n_eta n_N n_tau [n_test]]]\n";
+        return 1;
+    }
+    if(argc>=8) for(d=0; d<3; d++) {
+        lo[d] = atof(argv[2+2*d]);
+        hi[d] = atof(argv[3+2*d]);
+        if(d==0) { lo[d] = log10(lo[d]); hi[d] = log10(hi[d]); }
+    }
+    if(argc>=11) for(d=0; d<3; d++) n[d] = atoi(argv[8+d]);
+    if(argc>=12) n_test = atoi(argv[11]);
+    for(d=0; d<3; d++)
+        if(n[d]<1 || n[d]>EMULATOR_NMAX) nrerror("bad number of nodes in emulate");
+
+    // chebyshev nodes in the box
+    for(d=0; d<3; d++)
+        for(k=0; k<n[d]; k++)
+            x[d][k] = 0.5*(hi[d]+lo[d]) + 0.5*(hi[d]-lo[d])*cos(PI*(k+0.5)/n[d]);
+
+    // sample solver (N_nu outermost to reuse expansion tables)
+    N = BBN::N_element;
+    std::vector<double> f(size_t(N)*n[0]*n[1]*n[2]), Y(N);
+    for(i1=0; i1<n[1]; i1++) {
+        for(i0=0; i0<n[0]; i0++) {
+            for(i2=0; i2<n[2]; i2++) {
+                solve(&Y[0], pow(10., x[0][i0]), x[1][i1], x[2][i2]);
+                for(j=0; j<N; j++)
+                    f[((j*n[0] + i0)*n[1] + i1)*n[2] + i2] = Y[j];
+            }
+        }
+        std::cout << "N_nu = " << x[1][i1] << '\n';
+    }
+    chebft(f, N, n[0], n[1]*n[2]);
+    chebft(f, N*n[0], n[1], n[2]);
+    chebft(f, N*n[0]*n[1], n[2], 1);
+
+    memcpy(e.h.magic, EMULATOR_MAGIC, 4);
+    e.h.version = EMULATOR_VERSION;
+    e.h.n_out = N;
+    for(d=0; d<3; d++) {
+        e.h.n[d] = n[d];
+        e.h.lo[d] = lo[d];
+        e.h.hi[d] = hi[d];
+    }
+    e.h.T_init = T0;
+    e.h.T_final = T1;
+    e.coef.swap(f);
+
+    // validate against fresh solves at random points in the box
+    std::vector<double> Z(N);
+    srand(1);
+    for(i=0; i<n_test; i++) {
+        for(d=0; d<3; d++)
+            p[d] = lo[d] + (hi[d]-lo[d])*rand()/RAND_MAX;
+        solve(&Y[0], pow(10., p[0]), p[1], p[2]);
+        e.eval_log(pow(10., p[0]), p[1], p[2], &Z[0]);
+        for(j=0; j<N; j++) {
+            err = fabs(Y[j] - Z[j]);
+            if(err > maxerr) maxerr = err;
+        }
+    }
+    e.h.max_error = maxerr;
+    if(!e.save(argv[1])) nrerror("cannot write emulator file");
+
+    // latency of evaluation
+    auto t0(std::chrono::steady_clock::now());
+    for(i=0; i<100000; i++) {
+        e.eval(pow(10., lo[0]+(hi[0]-lo[0])*(i%97)/97.), p[1], p[2], &Z[0]);
+        sink = Z[0];
+    }
+    (void)sink;
+    auto t1(std::chrono::steady_clock::now());
+    std::cout << "max error of log10(X) = " << maxerr
+              << " (" << n_test << " points)\n";
+    std::cout << "evaluation time = "
+              << std::chrono::duration<double, std::micro>(t1-t0).count()/i
+              << " usec\n";
+    return 0;
+}
+catch(const nr_error& e) {
+    std::cerr << "emulate: " << e.what() << '\n';
+    return 1;
+}
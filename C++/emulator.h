@@ -0,0 +1,113 @@
+// Chebyshev emulator of final mass fractions
+// (header only evaluator of tables made by emulate.cpp)
+// reference:
+//   W. H. Press, et al, "Numerical Recipes" section 5.8
+
+#ifndef __emulator_h__
+#define __emulator_h__
+
+#include<cmath>
+#include<cstdio>
+#include<cstring>
+#include<vector>
+
+#define EMULATOR_MAGIC "BBNE"
+#define EMULATOR_VERSION 1
+#define EMULATOR_DIM 3// (log10(eta), N_nu, tau)
+#define EMULATOR_NMAX 64// max number of chebyshev coefficients
+#define EMULATOR_OUTMAX 1024// max number of elements
+
+struct emulator_header {
+    char magic[4];
+    int version;
+    int n_out;// number of elements
+    int n[EMULATOR_DIM];// number of chebyshev coefficients
+    double lo[EMULATOR_DIM];// lower bound of box
+    double hi[EMULATOR_DIM];// upper bound of box
+    double T_init;// initial temperature / MeV
+    double T_final;// temperature of emulated abundances / MeV
+    double max_error;// validated max error of log10(X)
+};
+
+struct emulator {
+    emulator_header h;
+    std::vector<double> coef;// coef[((j*n0 + i0)*n1 + i1)*n2 + i2]
+
+    inline bool load(const char *fname)
+    // read emulator from binary file; return false if failed
+    // (or if header is out of range or size of file does not match)
+    {
+        FILE *fp(fopen(fname, "rb"));
+        if(fp==0) return false;
+        int d;
+        long size(-1);
+        bool ok(fread(&h, sizeof(h), 1, fp) == 1 &&
+                strncmp(h.magic, EMULATOR_MAGIC, 4) == 0 &&
+                h.version == EMULATOR_VERSION &&
+                h.n_out >= 1 && h.n_out <= EMULATOR_OUTMAX);
+        for(d=0; ok && d<EMULATOR_DIM; d++)
+            ok = (h.n[d] >= 1 && h.n[d] <= EMULATOR_NMAX && h.lo[d] < h.hi[d]);
+        if(ok) {
+            coef.resize(size_t(h.n_out)*h.n[0]*h.n[1]*h.n[2]);
+            if(fseek(fp, 0, SEEK_END) == 0) size = ftell(fp);
+            ok = (size == long(sizeof(h) + sizeof(double)*coef.size()) &&
+                  fseek(fp, sizeof(h), SEEK_SET) == 0 &&
+                  fread(&coef[0], sizeof(double), coef.size(), fp) == coef.size());
+        }
+        fclose(fp);
+        if(!ok) coef.clear();
+        return ok;
+    }
+    inline bool save(const char *fname) const
+    // write emulator to binary file; return false if failed
+    {
+        FILE *fp(fopen(fname, "wb"));
+        if(fp==0) return false;
+        bool ok(fwrite(&h, sizeof(h), 1, fp) == 1 &&
+                fwrite(&coef[0], sizeof(double), coef.size(), fp) == coef.size());
+        return fclose(fp)==0 && ok;
+    }
+    inline static void chebyshev(double *T, int n, double x)
+    // T[k] = k-th chebyshev polynomial at x (-1<=x<=1), k<n
+    {
+        T[0] = 1;
+        if(n>1) T[1] = x;
+        for(int k=2; k<n; k++) T[k] = 2*x*T[k-1] - T[k-2];
+    }
+    inline void eval_log(double eta, double N_nu, double tau, double *Y) const
+    // input: eta = baryon to photon ratio
+    //        N_nu = number of neutrino generation
+    //        tau = neutron lifetime / sec
+    // output: Y[j] = log10 of mass fraction of element j at T_final
+    // parameters outside of box are extrapolated
+    {
+        double p[EMULATOR_DIM] = { log10(eta), N_nu, tau };
+        double T[EMULATOR_DIM][EMULATOR_NMAX], a, b;
+        int d,j,i0,i1,i2;
+        const double *c(&coef[0]);
+        for(d=0; d<EMULATOR_DIM; d++) {
+            a = (2*p[d] - h.lo[d] - h.hi[d])/(h.hi[d] - h.lo[d]);
+            chebyshev(T[d], h.n[d], a);
+        }
+        for(j=0; j<h.n_out; j++) {
+            Y[j] = 0;
+            for(i0=0; i0<h.n[0]; i0++) {
+                a = 0;
+                for(i1=0; i1<h.n[1]; i1++) {
+                    b = 0;
+                    for(i2=0; i2<h.n[2]; i2++) b += T[2][i2]*(*c++);
+                    a += T[1][i1]*b;
+                }
+                Y[j] += T[0][i0]*a;
+            }
+        }
+    }
+    inline void eval(double eta, double N_nu, double tau, double *X) const
+    // same as eval_log but X[j] = mass fraction of element j
+    {
+        eval_log(eta, N_nu, tau, X);
+        for(int j=0; j<h.n_out; j++) X[j] = pow(10., X[j]);
+    }
+};
+
+#endif // __emulator_h__
@@ -6,26 +6,48 @@
 //     "The Early Universe" chapter 3
 
 #include<cmath>
+#include<vector>
+#include<algorithm>
+#include<atomic>
+#include<condition_variable>
+#include<exception>
+#include<functional>
+#include<mutex>
+#include<thread>
+#include "stats.h"
+#include "trace.h"
+#include "baked.h"
 #include "BBN.h"
 
-static int N(64);// number of nodes for quadrature
-static Vec_DP y(2);// dependent variable of diff_eq
-static Vec_DP node(N), weight(0.,N), ex(N);
-static double temperature;// current temperature
-static double a_nu;// neutrino radiation const
+static thread_local int N(0);// number of nodes for quadrature
+static thread_local Vec_DP node, weight, ex;
+static thread_local Vec_DP y(2);// dependent variable of diff_eq
+static thread_local double temperature;// current temperature
+static thread_local double a_nu;// neutrino radiation const
 
 void expansion_init(double T0, double N_nu)
 // T0 = initial temperature / MeV
 // N_nu = number of neutrino generation
 {
-    int i;
     temperature = T0;
     a_nu = a_rad*0.875*N_nu;// neutrino radiation const
     y[0] = 0; // time
     y[1] = T0;// neutrino temperature
-    if(weight[0]) return;
-    gaulag(node, weight, 0);// execute only once
-    for(i=0; i<N; i++) ex[i] = exp(-node[i]);
+    if(N == BBN::prec.N_quad) return;
+    N = BBN::prec.N_quad;// number of nodes is changed
+    const baked_quadrature *q(baked_quad);
+    while(q->N && q->N != N) q++;
+    if(q->N) {// compiled in by bake
+        node = Vec_DP(q->x, N);
+        weight = Vec_DP(q->w, N);
+    }
+    else {
+        node = Vec_DP(N);
+        weight = Vec_DP(0.,N);
+        gaulag(node, weight, 0);
+    }
+    ex = Vec_DP(N);
+    for(int i=0; i<N; i++) ex[i] = exp(-node[i]);
 }
 
 void expansion_eq(double T, const Vec_DP& y, Vec_DP& f)
@@ -76,7 +98,7 @@ void expansion(double& t, double& T_nu, double T)
 // output: t = time since T=T0 / sec
 //         T_nu = neutrino temperature / MeV
 {
-    odeint(y, expansion_eq, temperature, T, 1e-9);
+    odeint(y, expansion_eq, temperature, T, BBN::prec.eps_expansion);
     temperature = T;
     t = y[0];
     T_nu = y[1];
@@ -125,47 +147,314 @@ void weak_rate(double& p_n, double& n_p, double T, double T_nu, double tau)
     n_p *= v;
 }
 
-static int M(256);// number of grid points for interpolation
-Vec_DP BBN::x0(M), BBN::x1(M);// interplation variables
-Vec_DP BBN::y0(M), BBN::dy0(M);
-Vec_DP BBN::y1(M), BBN::dy1(M);
-Vec_DP BBN::y2(M), BBN::dy2(M);
-Vec_DP BBN::y3(M), BBN::dy3(M);
-Vec_DP BBN::y4(M), BBN::dy4(M);
+// tiers of accuracy; budget is checked by tiers.cpp
+// (gaulag does not converge for N_quad > 90);
+// no tier is looser than standard, since tables are baked (looser
+// tables save nothing) and network with eps > 3e-6 is erratic (error
+// of He4 jumps to 10% at eps=1e-5), so that speedup is 25% at most
+const BBN_precision BBN::tier[] = {
+    // name, N_quad, N_grid, eps_grid, interp,
+    //   eps_expansion, eps, eps_jac, budget
+    { "standard",   64,  256, 1e-5, CUBIC_SPLINE, 1e-9,  1e-6, 1e-8, 1e-4 },
+    { "reference",  80, 1024, 1e-8, CUBIC_SPLINE, 1e-12, 1e-9, 1e-8, 0 },
+    { 0 }
+};
+thread_local BBN_precision BBN::prec(tier[0]);// accuracy settings
+
+thread_local Vec_DP BBN::x0, BBN::x1;// interplation variables
+thread_local Vec_DP BBN::y0, BBN::dy0;
+thread_local Vec_DP BBN::y1, BBN::dy1;
+thread_local Vec_DP BBN::y2, BBN::dy2;
+thread_local Vec_DP BBN::y3, BBN::dy3;
+thread_local Vec_DP BBN::y4, BBN::dy4;
+thread_local Vec_DP BBN::y5, BBN::dy5;
+thread_local int BBN::interpolation(CUBIC_SPLINE);// method of tables
+thread_local double BBN::grid_error(0);// estimated error of tables
+static thread_local double T_init_(0), T_final_, N_nu_;// inputs of interp_init
+static thread_local BBN_precision prec_;// accuracy of interp_init
+static double T_zero(100);// temperature at time=0 / MeV
+
+struct grid_node {// values of tabulated functions at one temperature
+    double T;// temperature / MeV
+    double t;// time since T=T_zero / sec
+    double r;// T_nu/T
+    double p_n, n_p;// weak interaction rates / sec^-1
+    double s;// -dt/dln(T) / sec
+};
+
+static void grid_expansion(grid_node& a, const grid_node& b, double T)
+// input: b = node from which expansion is integrated
+//        T = temperature / MeV
+// output: a.T, a.t, a.r, a.s = node at T
+{
+    double T_nu;
+    Vec_DP f(2);
+    temperature = b.T;
+    y[0] = b.t;
+    y[1] = b.r*b.T;
+    a.T = T;
+    expansion(a.t, T_nu, T);
+    a.r = T_nu/T;
+    expansion_eq(T, y, f);
+    a.s = -f[0]*T;
+}
+
+static void grid_weak(grid_node& a)
+// input: a.T, a.r = node
+// output: a.p_n, a.n_p = weak rates at node
+{ weak_rate(a.p_n, a.n_p, a.T, a.r*a.T); }
+
+int BBN::table_threads(MAX(1u, std::thread::hardware_concurrency()));
+
+static void parallel(int n, double N_nu, const std::function<void(int)>& f)
+// call f(0),...,f(n-1) on up to BBN::table_threads threads including
+// calling thread, where f(i) is started in increasing order of i;
+// on other threads, expansion is initialized with N_nu and accuracy
+// settings of calling thread;
+// if some f(i) throws, f(j) not yet started are skipped, and first
+// exception is rethrown on calling thread after all threads are joined
+{
+    std::atomic<int> next(0);
+    std::mutex lock;// for error
+    std::exception_ptr error;
+    BBN_precision p(BBN::prec);
+    auto work = [&](bool other) {
+        try {
+            if(other) {
+                BBN::prec = p;
+                expansion_init(T_zero, N_nu);
+            }
+            for(int i; (i = next++) < n;) f(i);
+        }
+        catch(...) {
+            next = n;
+            std::lock_guard<std::mutex> l(lock);
+            if(!error) error = std::current_exception();
+        }
+    };
+    std::vector<std::thread> t;
+    for(int k=1; k < MIN(BBN::table_threads, n); k++)
+        t.emplace_back(work, true);
+    work(false);
+    for(size_t k=0; k<t.size(); k++) t[k].join();
+    if(error) std::rethrow_exception(error);
+}
+
+static void grid_table(const std::vector<grid_node>& g)
+// fill interpolation variables with nodes g (decreasing T)
+{
+    int i,j,M(g.size());
+    if(BBN::x0.size() != M) {
+        BBN::x0 = BBN::x1 = BBN::y0 = BBN::y1 = Vec_DP(M);
+        BBN::y2 = BBN::y3 = BBN::y4 = BBN::y5 = Vec_DP(M);
+        BBN::dy0 = BBN::dy1 = BBN::dy2 = BBN::dy3 = BBN::dy4 = BBN::dy5 = Vec_DP(M);
+    }
+    for(i=0, j=M-1; i<M; i++, j--) {
+        BBN::x0[i] = g[i].t;// time (incresing order)
+        BBN::x1[j] = g[i].T;// temperature (incresing order)
+        BBN::y0[i] = g[i].T;// temperature (decresing order)
+        BBN::y1[j] = g[i].t;// time (decresing order)
+        BBN::y2[j] = g[i].r;
+        BBN::y3[j] = g[i].p_n;
+        BBN::y4[j] = g[i].n_p;
+        BBN::y5[j] = g[i].s;
+    }
+    TRACE("spline");
+    // derivatives dy0,...,dy5 of tables by spline (or pchip)
+    const Vec_DP *x[] = { &BBN::x0, &BBN::x1, &BBN::x1, &BBN::x1, &BBN::x1, &BBN::x1 };
+    const Vec_DP *y[] = { &BBN::y0, &BBN::y1, &BBN::y2, &BBN::y3, &BBN::y4, &BBN::y5 };
+    Vec_DP *d[] = { &BBN::dy0, &BBN::dy1, &BBN::dy2, &BBN::dy3, &BBN::dy4, &BBN::dy5 };
+    for(int k=0; k<6; k++)// too short to be worth threads
+        if(BBN::interpolation == MONOTONE_CUBIC) pchip(*x[k], *y[k], *d[k]);
+        else spline(*x[k], *y[k], 1e30, 1e30, *d[k]);
+}
+
+static double node_error(const grid_node& a)
+// return relative error of interpolation tables at node a:
+// max of errors in t(T), T(t), T_nu/T, weak rates and dt/dln(T), where
+// error of each weak rate is relative to sum of both rates
+{
+    double e,w(a.p_n + a.n_p);
+    e = fabs(BBN::interp(BBN::x1, BBN::y1, BBN::dy1, a.T)/a.t - 1);
+    e = MAX(e, fabs(BBN::interp(BBN::x0, BBN::y0, BBN::dy0, a.t)/a.T - 1));
+    e = MAX(e, fabs(BBN::interp(BBN::x1, BBN::y2, BBN::dy2, a.T)/a.r - 1));
+    e = MAX(e, fabs(BBN::interp(BBN::x1, BBN::y3, BBN::dy3, a.T) - a.p_n)/w);
+    e = MAX(e, fabs(BBN::interp(BBN::x1, BBN::y4, BBN::dy4, a.T) - a.n_p)/w);
+    e = MAX(e, fabs(BBN::interp(BBN::x1, BBN::y5, BBN::dy5, a.T)/a.s - 1));
+    return e;
+}
+
+static bool load_baked(double T_init, double T_final, double N_nu)
+// load interpolation variables from tables compiled in by bake if
+// they are made with same inputs and accuracy; return false if not
+{
+    const BBN_precision& p(BBN::prec);
+    const baked_table *b(baked_tables);
+    for(; b->tier; b++)
+        if(b->T_init == T_init && b->T_final == T_final && b->N_nu == N_nu
+           && b->N_quad == p.N_quad && b->N_grid == p.N_grid
+           && b->eps_grid == p.eps_grid && b->interp == p.interp
+           && b->eps_expansion == p.eps_expansion) break;
+    if(!b->tier) return false;
+    Vec_DP *v[] = { &BBN::x0, &BBN::x1, &BBN::y0, &BBN::y1, &BBN::y2,
+                    &BBN::y3, &BBN::y4, &BBN::y5, &BBN::dy0, &BBN::dy1,
+                    &BBN::dy2, &BBN::dy3, &BBN::dy4, &BBN::dy5 };
+    for(int k=0; k<14; k++) *v[k] = Vec_DP(b->v[k], b->n);
+    BBN::grid_error = b->grid_error;
+    expansion_init(T_zero, N_nu);// for expansion_rate
+    return true;
+}
 
 void BBN::interp_init(double T_init, double T_final, double N_nu)
 // initialize interpolation variables
 // T_init = max temperature / MeV
 // T_final = min temperature / MeV
 // N_nu = number of neutrino generation
+// if prec.eps_grid > 0, grid is refined adaptively: starting from
+// coarse grid uniform in ln(T), intervals are bisected in ln(T) while
+// error of interpolation at midpoint (see node_error) exceeds eps_grid
+// or until number of points reaches prec.N_grid;
+// max error at midpoints is set to grid_error;
+// tables for default inputs are compiled in by bake (see baked.h)
 {
-    static double T0(100);// temperature at time=0 / MeV
-    static double T_init_(0), T_final_, N_nu_;// previous inputs
-    int i,j;
-    double T, dT, t, T_nu, p_n, n_p;
+    const int M0(17);// number of points of initial grid
+    int i,k,M(prec.N_grid);
+    double dT;
     // check if parameters change
-    if(T_init == T_init_ && T_final == T_final_ && N_nu == N_nu_)
+    if(T_init == T_init_ && T_final == T_final_ && N_nu == N_nu_
+       && prec.N_quad == prec_.N_quad && M == prec_.N_grid
+       && prec.eps_grid == prec_.eps_grid && prec.interp == prec_.interp
+       && prec.eps_expansion == prec_.eps_expansion)
         return;
-    T_init_ = T_init; T_final_ = T_final; N_nu_ = N_nu;
+    T_init_ = 0;// tables are invalid until they are built
+    interpolation = prec.interp;
+    solver_stats s(stats);// exclude expansion from statistics
+    double t0(s.on ? s.clock() : 0);
 
-    expansion_init(T0, N_nu);
+    TRACE("interp_init");
+    if(load_baked(T_init, T_final, N_nu)) {
+        T_init_ = T_init; T_final_ = T_final; N_nu_ = N_nu;
+        prec_ = prec;
+        if(s.on) s.t_interp += s.clock() - t0;
+        stats = s;
+        return;
+    }
+    std::vector<grid_node> g, mid;// nodes and midpoints of intervals
+    grid_node a;
+    expansion_init(T_zero, N_nu);
+    a.T = T_zero; a.t = 0; a.r = 1;
+    if(prec.eps_grid > 0) M = MIN(M, M0);
     dT = pow(T_final/T_init, 1./(M-1));
-    for(i=0, j=M-1; i<M; i++, j--) {
-        T = T_init*pow(dT,i);
-        expansion(t, T_nu, T);
-        weak_rate(p_n, n_p, T, T_nu);
-        x0[i] = t;// time (incresing order)
-        x1[j] = T;// temperature (incresing order)
-        y0[i] = T;// temperature (decresing order)
-        y1[j] = t;// time (decresing order)
-        y2[j] = T_nu/T;
-        y3[j] = p_n;
-        y4[j] = n_p;
+    g.resize(M);
+    {// pipeline: f(0) integrates expansion sequentially to every
+     // S-th node, while f(i) integrates from (i-1)*S-th node to
+     // following S-1 nodes and computes weak rates at them
+        TRACE("expansion");
+        const int S(16);
+        std::mutex lock;
+        std::condition_variable cv;
+        int ready(0);// number of nodes integrated by f(0)
+        bool failed(false);// f(0) has thrown
+        parallel((M-1)/S+2, N_nu, [&](int i) {
+            int j,j1;
+            if(i==0) {
+                try {
+                    for(j=0; j<M; j+=S) {
+                        grid_expansion(a, a, T_init*pow(dT,j));
+                        std::lock_guard<std::mutex> l(lock);
+                        g[j] = a;
+                        ready++;
+                        cv.notify_all();
+                    }
+                }
+                catch(...) {// release waiting segments
+                    std::lock_guard<std::mutex> l(lock);
+                    failed = true;
+                    cv.notify_all();
+                    throw;
+                }
+                return;
+            }
+            std::unique_lock<std::mutex> l(lock);
+            cv.wait(l, [&]{ return ready >= i || failed; });
+            if(failed) return;
+            l.unlock();
+            TRACE_ARG("segment", "T", g[(i-1)*S].T);
+            j1 = MIN(i*S, M);
+            for(j=(i-1)*S+1; j<j1; j++)
+                grid_expansion(g[j], g[j-1], T_init*pow(dT,j));
+            for(j=(i-1)*S; j<j1; j++) grid_weak(g[j]);
+        });
+    }
+    grid_table(g);
+    grid_error = 0;
+    while(prec.eps_grid > 0) {// adaptive refinement
+        TRACE_ARG("refine", "points", g.size());
+        std::vector<double> e(g.size()-1);
+        mid.resize(e.size());
+        std::vector<int> m;// new intervals
+        for(i=0; i<int(e.size()); i++) if(mid[i].T == 0) m.push_back(i);
+        parallel(m.size(), N_nu, [&](int k) {
+            int j(m[k]);
+            grid_expansion(mid[j], g[j], sqrt(g[j].T*g[j+1].T));
+            grid_weak(mid[j]);
+        });
+        for(i=0; i<int(e.size()); i++) e[i] = node_error(mid[i]);
+        grid_error = *std::max_element(e.begin(), e.end());
+        k = prec.N_grid - g.size();// max number of bisections
+        if(grid_error <= prec.eps_grid || k <= 0) break;
+        // bisect intervals of error > e1, worst first so that
+        // error is balanced when number of points reaches N_grid
+        double e1(MAX(prec.eps_grid, grid_error/16));
+        if(k < int(e.size())) {
+            std::vector<double> f(e);
+            std::nth_element(f.begin(), f.end()-k-1, f.end());
+            e1 = MAX(e1, f.end()[-k-1]);
+        }
+        std::vector<grid_node> g1, mid1;
+        for(i=0; i<int(e.size()); i++) {
+            g1.push_back(g[i]);
+            mid1.push_back(mid[i]);
+            if(e[i] <= e1) continue;
+            g1.push_back(mid[i]);
+            mid1.back().T = 0;
+            mid1.push_back(mid1.back());
+        }
+        if(g1.size() + 1 == g.size()) break;// ties at e1
+        g1.push_back(g.back());
+        g.swap(g1);
+        mid.swap(mid1);
+        grid_table(g);
     }
-    // spline interpolation
-    spline(x0,y0,1e30,1e30,dy0);
-    spline(x1,y1,1e30,1e30,dy1);
-    spline(x1,y2,1e30,1e30,dy2);
-    spline(x1,y3,1e30,1e30,dy3);
-    spline(x1,y4,1e30,1e30,dy4);
+    T_init_ = T_init; T_final_ = T_final; N_nu_ = N_nu;
+    prec_ = prec;
+    if(s.on) s.t_interp += s.clock() - t0;
+    stats = s;
+}
+void BBN::save_table(BBN_table& a)
+// copy interpolation variables of calling thread to a
+{
+    a.T_init = T_init_; a.T_final = T_final_; a.N_nu = N_nu_;
+    a.x0 = x0; a.x1 = x1;
+    a.y0 = y0; a.y1 = y1; a.y2 = y2; a.y3 = y3; a.y4 = y4; a.y5 = y5;
+    a.dy0 = dy0; a.dy1 = dy1; a.dy2 = dy2; a.dy3 = dy3; a.dy4 = dy4; a.dy5 = dy5;
+}
+
+void BBN::table_inputs(double& T_init, double& T_final, double& N_nu)
+// return parameters of last interp_init of calling thread
+{
+    T_init = T_init_; T_final = T_final_; N_nu = N_nu_;
+}
+
+void BBN::load_table(const BBN_table& a)
+// restore interpolation variables saved by save_table,
+// so that following interp_init with same inputs does nothing
+{
+    T_init_ = a.T_init; T_final_ = a.T_final; N_nu_ = a.N_nu;
+    prec_ = prec;// assume tables are made with current accuracy
+    expansion_init(T_zero, N_nu_);// for expansion_rate
+    interpolation = prec.interp;
+    x0 = a.x0; x1 = a.x1;
+    y0 = a.y0; y1 = a.y1; y2 = a.y2; y3 = a.y3; y4 = a.y4; y5 = a.y5;
+    dy0 = a.dy0; dy1 = a.dy1; dy2 = a.dy2; dy3 = a.dy3; dy4 = a.dy4; dy5 = a.dy5;
 }
\ No newline at end of file
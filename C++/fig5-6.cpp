@@ -1,19 +1,93 @@
 #include<cmath>
+#include<cstdlib>
+#include<cstring>
 #include<fstream>
+#include "column.h"
+#include "stats.h"
+#include "writer.h"
+#include "trace.h"
+#include "observer.h"
 #include "BBN.h"
 
-main() {
-    std::ofstream f("fig5-6.txt");
+// usage: fig5-6 [-b] [-s] [-l] [-n] [-p tier] [-H] [-K] [-q ratio] [-T] [-o] [-t]
+//   -b: write columnar binary fig5-6.bbnc
+//   -s: print solver statistics to stderr
+//   -l: integrate logarithm of abundances
+//   -n: start from nuclear statistical equilibrium
+//   -p tier: precision tier (standard or reference)
+//   -H: solve linear systems in stifbs by Hessenberg reduction
+//   -K: solve linear systems in stifbs by GMRES (KRYLOV_SOLVER)
+//   -q ratio: quasi-steady state of fast elements (see BBN::qss_ratio)
+//   -T: integrate in ln(T) instead of time (see BBN::log_temperature)
+//   -o: integrate once to T=0.01MeV and output first accepted step
+//       at or below each temperature (see log_recorder)
+//   -t: write timeline trace fig5-6.json (if compiled with -DBBN_TRACE)
+int main(int argc, char **argv) try {
+    std::ofstream f;
+    column_writer b;
     int i,j,n(256);
     double eta(5e-10), T0(10), T1(0.01);
     double T, dT(pow(T1/T0, 1./n));
+    bool binary(false), trace(false), observe(false);
+    Vec_DP X(BBN::N_element + 1);
+    for(i=1; i<argc; i++) {
+        if(strcmp(argv[i],"-b")==0) binary = true;
+        else if(strcmp(argv[i],"-s")==0) stats.on = true;
+        else if(strcmp(argv[i],"-t")==0) trace = true;
+        else if(strcmp(argv[i],"-l")==0) BBN::log_abundance = true;
+        else if(strcmp(argv[i],"-n")==0) BBN::nse_start = true;
+        else if(strcmp(argv[i],"-H")==0) linear_solver = HESSENBERG_SOLVER;
+        else if(strcmp(argv[i],"-K")==0) linear_solver = KRYLOV_SOLVER;
+        else if(strcmp(argv[i],"-T")==0) BBN::log_temperature = true;
+        else if(strcmp(argv[i],"-o")==0) observe = true;
+        else if(strcmp(argv[i],"-q")==0 && i+1<argc) BBN::qss_ratio = atof(argv[++i]);
+        else if(strcmp(argv[i],"-p")==0 && i+1<argc) {
+            if(!BBN::precision(argv[++i])) { std::cerr << "unknown tier " << argv[i] << '\n'; return 1; }
+        }
+    }
     BBN::init(eta, T0, T1);
-    for(i=0; i<=n; i++) {
-        T = T0*pow(dT,i);
-        BBN::set_temperature(T);
-        f << T;
+    if(binary) {
+        b.parameter("eta", eta);
+        b.parameter("tau", tau_n, "sec");
+        b.parameter("N_nu", 3);
+        b.column("T", "MeV");
         for(j=0; j<BBN::N_element; j++)
-            f << ' ' << BBN::mass_fraction(j);
-        f << '\n';
+            b.column(BBN::element[j].name.c_str(), "", COLUMN_XOR_RLE);
+        b.open("fig5-6.bbnc");
+    }
+    else f.open("fig5-6.txt");
+    async_writer w(f);
+    std::string s;
+    log_recorder r(T0, T1, n+1);
+    if(observe) {
+        BBN::observer = &r;
+        if(BBN::set_temperature(T1)) nrerror(BBN::error.c_str());
+        BBN::observer = 0;
+        n = r.n-1;
+    }
+    for(i=0; i<=n; i++) {
+        if(observe) {
+            const double *p(r.record(i));
+            X[0] = T = p[1];
+            for(j=0; j<BBN::N_element; j++) X[j+1] = BBN::element[j].A * p[j+2];
+        }
+        else {
+            T = T0*pow(dT,i);
+            if(BBN::set_temperature(T)) nrerror(BBN::error.c_str());
+            X[0] = T;
+            for(j=0; j<BBN::N_element; j++) X[j+1] = BBN::mass_fraction(j);
+        }
+        if(binary) { b.write(&X[0]); continue; }
+        put(s, T);
+        for(j=0; j<BBN::N_element; j++) { s += ' '; put(s, X[j+1]); }
+        s += '\n';
+        w.write(s);
     }
-}
\ No newline at end of file
+    if(stats.on) stats.print(std::cerr);
+    if(trace) TRACE_DUMP("fig5-6.json");
+    return 0;
+}
+catch(const nr_error& e) {
+    std::cerr << "fig5-6: " << e.what() << '\n';
+    return 1;
+}
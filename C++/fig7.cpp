@@ -1,20 +1,103 @@
 #include<cmath>
+#include<cstdio>
+#include<cstdlib>
+#include<cstring>
 #include<fstream>
+#include "column.h"
+#include "stats.h"
+#include "writer.h"
+#include "trace.h"
 #include "BBN.h"
 
-main() {
-    std::ofstream f("fig7.txt");
-    int i,j,n(100);
+// usage: fig7 [-b] [-s] [-l] [-n] [-T] [-p tier] [-H] [-q ratio] [-t]
+//             [-c file [-i sec]]
+//   -b: write columnar binary fig7.bbnc
+//   -s: print solver statistics to stderr
+//   -l: integrate logarithm of abundances
+//   -n: start from nuclear statistical equilibrium
+//   -T: integrate in ln(T) instead of time (see BBN::log_temperature)
+//   -p tier: precision tier (standard or reference)
+//   -H: solve linear systems in stifbs by Hessenberg reduction
+//   -q ratio: quasi-steady state of fast elements (see BBN::qss_ratio)
+//   -t: write timeline trace fig7.json (if compiled with -DBBN_TRACE)
+//   -c file: write checkpoint of sweep to file (removed at the end),
+//            and resume from it if it exists (with options of the
+//            interrupted run instead of -l -n -T -p -H -q)
+//   -i sec: min interval of checkpoints (default 1)
+int main(int argc, char **argv) try {
+    std::ofstream f;
+    column_writer b;
+    int i,j,n(100),m(BBN::N_element + 1),i0(0);
     double eta0(1e-11), eta1(1e-8), T0(10), T1(0.01);
     double eta, de(pow(eta1/eta0, 1./n));
-    for(i=0; i<=n; i++) {
-        eta = eta0*pow(de,i);
-        BBN::init(eta, T0, T1);
-        BBN::set_temperature(T1);
-        f << eta;
+    bool binary(false), trace(false), resume(false);
+    const char *checkpoint(0);
+    Vec_DP X(BBN::N_element + 1);
+    for(i=1; i<argc; i++) {
+        if(strcmp(argv[i],"-b")==0) binary = true;
+        else if(strcmp(argv[i],"-s")==0) stats.on = true;
+        else if(strcmp(argv[i],"-t")==0) trace = true;
+        else if(strcmp(argv[i],"-l")==0) BBN::log_abundance = true;
+        else if(strcmp(argv[i],"-n")==0) BBN::nse_start = true;
+        else if(strcmp(argv[i],"-T")==0) BBN::log_temperature = true;
+        else if(strcmp(argv[i],"-H")==0) linear_solver = HESSENBERG_SOLVER;
+        else if(strcmp(argv[i],"-q")==0 && i+1<argc) BBN::qss_ratio = atof(argv[++i]);
+        else if(strcmp(argv[i],"-c")==0 && i+1<argc) checkpoint = argv[++i];
+        else if(strcmp(argv[i],"-i")==0 && i+1<argc)
+            BBN::checkpoint_interval = atof(argv[++i]);
+        else if(strcmp(argv[i],"-p")==0 && i+1<argc) {
+            if(!BBN::precision(argv[++i])) { std::cerr << "unknown tier " << argv[i] << '\n'; return 1; }
+        }
+    }
+    if(checkpoint && BBN::restore(checkpoint)) {
+        i0 = BBN::checkpoint_data.size()/m;// number of finished eta
+        // integration of eta[i0] is interrupted
+        resume = (BBN::time < BBN::expansion_time(T1));
+    }
+    BBN::checkpoint_file = checkpoint;
+    if(binary) {
+        b.parameter("T", T1, "MeV");
+        b.parameter("tau", tau_n, "sec");
+        b.parameter("N_nu", 3);
+        b.column("eta");
         for(j=0; j<BBN::N_element; j++)
-            f << ' ' << BBN::mass_fraction(j);
-        f << '\n';
-        std::cout << eta << '\n';
+            b.column(BBN::element[j].name.c_str(), "", COLUMN_XOR_RLE);
+        b.open("fig7.bbnc");
+    }
+    else f.open("fig7.txt");
+    async_writer w(f), w_eta(std::cout);
+    std::string s, s_eta;
+    for(i=0; i<=n; i++) {
+        if(i < i0) {// result in checkpoint
+            for(j=0; j<m; j++) X[j] = BBN::checkpoint_data[i*m + j];
+            eta = X[0];
+        }
+        else {
+            eta = eta0*pow(de,i);
+            if(i > i0 || !resume) BBN::init(eta, T0, T1);
+            if(BBN::set_temperature(T1)) nrerror(BBN::error.c_str());
+            X[0] = eta;
+            for(j=0; j<BBN::N_element; j++) X[j+1] = BBN::mass_fraction(j);
+            put(s_eta, eta, 6);
+            s_eta += '\n';
+            w_eta.write(s_eta);
+            if(checkpoint) {
+                BBN::checkpoint_data.insert(BBN::checkpoint_data.end(), &X[0], &X[0]+m);
+                BBN::checkpoint(false);
+            }
+        }
+        if(binary) { b.write(&X[0]); continue; }
+        put(s, eta);
+        for(j=0; j<BBN::N_element; j++) { s += ' '; put(s, X[j+1]); }
+        s += '\n';
+        w.write(s);
     }
-}
\ No newline at end of file
+    if(checkpoint) remove(checkpoint);
+    if(stats.on) stats.print(std::cerr);
+    if(trace) TRACE_DUMP("fig7.json");
+    return 0;
+}
+catch(const nr_error& e) {
+    std::cerr << "fig7: " << e.what() << '\n';
+    return 1;
+}
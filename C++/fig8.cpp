@@ -1,25 +1,62 @@
 #include<cmath>
+#include<cstring>
 #include<fstream>
+#include "column.h"
+#include "stats.h"
+#include "writer.h"
 #include "BBN.h"
 
-void fig8(const char *fname, double N_nu) {
-    std::ofstream f(fname);
+void fig8(const char *fname, double N_nu, bool binary) {
+    std::ofstream f;
+    column_writer b;
     int i,j,n(100);
     double eta0(1e-11), eta1(1e-8), T0(10), T1(0.01);
     double eta, de(pow(eta1/eta0, 1./n));
+    Vec_DP X(BBN::N_element + 1);
+    if(binary) {
+        b.parameter("T", T1, "MeV");
+        b.parameter("tau", tau_n, "sec");
+        b.parameter("N_nu", N_nu);
+        b.column("eta");
+        for(j=0; j<BBN::N_element; j++)
+            b.column(BBN::element[j].name.c_str(), "", COLUMN_XOR_RLE);
+        b.open((std::string(fname) + ".bbnc").c_str());
+    }
+    else f.open((std::string(fname) + ".txt").c_str());
+    async_writer w(f), w_eta(std::cout);
+    std::string s, s_eta;
     for(i=0; i<=n; i++) {
         eta = eta0*pow(de,i);
         BBN::init(eta, T0, T1, N_nu);
-        BBN::set_temperature(T1);
-        f << eta;
-        for(j=0; j<BBN::N_element; j++)
-            f << ' ' << BBN::mass_fraction(j);
-        f << '\n';
-        std::cout << eta << '\n';
+        if(BBN::set_temperature(T1)) nrerror(BBN::error.c_str());
+        X[0] = eta;
+        for(j=0; j<BBN::N_element; j++) X[j+1] = BBN::mass_fraction(j);
+        put(s_eta, eta, 6);
+        s_eta += '\n';
+        w_eta.write(s_eta);
+        if(binary) { b.write(&X[0]); continue; }
+        put(s, eta);
+        for(j=0; j<BBN::N_element; j++) { s += ' '; put(s, X[j+1]); }
+        s += '\n';
+        w.write(s);
     }
 }
 
-main() {
-    fig8("fig8_n2.txt", 2);
-    fig8("fig8_n4.txt", 4);
-}
\ No newline at end of file
+// usage: fig8 [-b] [-s]
+//   -b: write columnar binary fig8_n*.bbnc
+//   -s: print solver statistics to stderr
+int main(int argc, char **argv) try {
+    bool binary(false);
+    for(int i=1; i<argc; i++) {
+        if(strcmp(argv[i],"-b")==0) binary = true;
+        else if(strcmp(argv[i],"-s")==0) stats.on = true;
+    }
+    fig8("fig8_n2", 2, binary);
+    fig8("fig8_n4", 4, binary);
+    if(stats.on) stats.print(std::cerr);
+    return 0;
+}
+catch(const nr_error& e) {
+    std::cerr << "fig8: " << e.what() << '\n';
+    return 1;
+}
@@ -52,7 +52,7 @@ void gaulag(Vec_O_DP &x, Vec_O_DP &w, const DP alf)
             z=z1-p1/pp;
             if (fabs(z-z1) <= EPS) break;
         }
-        if (its >= MAXIT) nrerror("too many iterations in gaulag");
+        if (its >= MAXIT) nrerror("too many iterations in gaulag",NR_NO_CONVERGENCE);
         x[i]=z;
         w[i] = -exp(gammln(alf+n)-gammln(DP(n)))/(pp*n*p2);
     }
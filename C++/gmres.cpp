@@ -0,0 +1,99 @@
+// restarted GMRES(m) with right diagonal preconditioner
+// Y. Saad and M. H. Schultz, SIAM J. Sci. Stat. Comput. 7 (1986) 856
+// A is given only by products A*v, so that memory is O(m*n)
+// (Krylov basis) instead of O(n^2)
+
+#include <cmath>
+#include "nr.h"
+using namespace std;
+
+int gmres(void atimes(Vec_I_DP &, Vec_O_DP &), Vec_I_DP &pre, Vec_IO_DP &b,
+    const DP tol, const int m, const int maxit)
+// solve A x = b
+// input: atimes(v,w) computes w = A v
+//        pre = diagonal of preconditioner P ~ A (x = P^{-1} z)
+//        b = right hand side
+//        tol = tolerance of residual |b - A x| (absolute, so that it is
+//              reachable in floating point whatever |b| is)
+//        m = dimension of Krylov subspace before restart
+//        maxit = max number of products A*v
+// output: b = solution x, or iterate of least residual if residual
+//         stagnates above tol or maxit is reached
+// return: number of products A*v
+{
+    const DP STAG=0.5;// restart must reduce residual by this factor
+    int i,j,k,it=0;
+    DP beta,best,t,r;
+
+    int n=b.size();
+    Mat_DP v(m+1,n),H(m+1,m);
+    Vec_DP g(m+1),cs(m),sn(m),x(0.0,n),xbest(0.0,n),w(n),z(n);
+    best=0.0;
+    for (i=0;i<n;i++) best += b[i]*b[i];
+    best=sqrt(best);
+    if (best <= tol) {
+        b=0.0;
+        return 0;
+    }
+    for (;;) {// restart with residual r = b - A x
+        if (it) {
+            atimes(x,w);
+            it++;
+            for (i=0;i<n;i++) w[i]=b[i]-w[i];
+        }
+        else for (i=0;i<n;i++) w[i]=b[i];
+        beta=0.0;
+        for (i=0;i<n;i++) beta += w[i]*w[i];
+        beta=sqrt(beta);
+        if (it && beta < best) {
+            xbest=x;
+            if (beta <= tol || beta > STAG*best || it >= maxit) break;
+            best=beta;
+        }
+        else if (it) break;// stagnation (in roundoff)
+        for (i=0;i<n;i++) v[0][i]=w[i]/beta;
+        g=0.0;
+        g[0]=beta;
+        for (k=0;k<m && it<maxit;) {// Arnoldi with modified Gram-Schmidt
+            for (i=0;i<n;i++) z[i]=v[k][i]/pre[i];
+            atimes(z,w);
+            it++;
+            for (j=0;j<=k;j++) {
+                for (t=0.0,i=0;i<n;i++) t += w[i]*v[j][i];
+                H[j][k]=t;
+                for (i=0;i<n;i++) w[i] -= t*v[j][i];
+            }
+            for (t=0.0,i=0;i<n;i++) t += w[i]*w[i];
+            H[k+1][k]=t=sqrt(t);
+            if (t != 0.0)
+                for (i=0;i<n;i++) v[k+1][i]=w[i]/t;
+            for (j=0;j<k;j++) {// apply previous Givens rotations
+                t=cs[j]*H[j][k]+sn[j]*H[j+1][k];
+                H[j+1][k]=-sn[j]*H[j][k]+cs[j]*H[j+1][k];
+                H[j][k]=t;
+            }
+            r=sqrt(SQR(H[k][k])+SQR(H[k+1][k]));
+            if (r == 0.0) nrerror("Breakdown in gmres",NR_SINGULAR);
+            cs[k]=H[k][k]/r;
+            sn[k]=H[k+1][k]/r;
+            H[k][k]=r;
+            H[k+1][k]=0.0;
+            g[k+1]=-sn[k]*g[k];
+            g[k]=cs[k]*g[k];
+            k++;
+            if (fabs(g[k]) <= tol) break;
+        }
+        for (j=k-1;j>=0;j--) {// solve H y = g, and x += P^{-1} V y
+            for (t=g[j],i=j+1;i<k;i++) t -= H[j][i]*g[i];
+            g[j]=t/H[j][j];
+        }
+        for (j=0;j<k;j++)
+            for (i=0;i<n;i++) x[i] += g[j]*v[j][i]/pre[i];
+        if (fabs(g[k]) <= tol) {// by estimate of residual
+            xbest=x;
+            break;
+        }
+    }
+    for (i=0;i<n;i++) b[i]=xbest[i];
+    return it;
+}
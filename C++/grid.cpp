@@ -0,0 +1,104 @@
+// accuracy of interpolation tables (see BBN::interp_init):
+// build tables on uniform and adaptive grids with cubic spline and
+// monotone cubic, and compare interpolated t(T), T(t), T_nu/T and
+// weak rates with direct evaluation at test temperatures
+// usage: grid [-n points] [-j threads]
+//   -n points: number of test temperatures (default 2000)
+//   -j threads: number of threads for interp_init (BBN::table_threads)
+// output: for each grid, number of nodes, error estimated by
+//   interp_init, max error at test temperatures (same measure as
+//   interp_init), wall time of interp_init, and max relative error
+//   of mass fractions at T=0.01MeV (eta=5e-10) from reference grid
+
+#include<cmath>
+#include<cstdlib>
+#include<cstring>
+#include<vector>
+#include "stats.h"
+#include "BBN.h"
+
+struct grid {
+    const char *name;
+    int N_grid;
+    double eps_grid;
+    int interp;
+};
+
+static const grid G[] = {
+    { "uniform",  1024, 0, CUBIC_SPLINE },// reference
+    { "uniform",    64, 0, CUBIC_SPLINE },
+    { "uniform",   128, 0, CUBIC_SPLINE },
+    { "uniform",   256, 0, CUBIC_SPLINE },
+    { "uniform",   512, 0, CUBIC_SPLINE },
+    { "uniform",   256, 0, MONOTONE_CUBIC },
+    { "uniform",  1024, 0, MONOTONE_CUBIC },
+    { "adaptive", 1024, 1e-4, CUBIC_SPLINE },
+    { "adaptive", 1024, 1e-5, CUBIC_SPLINE },
+    { "adaptive", 1024, 1e-6, CUBIC_SPLINE },
+    { "adaptive", 1024, 1e-7, CUBIC_SPLINE },
+    { "adaptive", 1024, 1e-8, CUBIC_SPLINE },
+    { "adaptive", 1024, 1e-4, MONOTONE_CUBIC },
+    { "adaptive", 1024, 1e-5, MONOTONE_CUBIC },
+    { "adaptive", 1024, 1e-6, MONOTONE_CUBIC },
+    { "adaptive", 1024, 1e-7, MONOTONE_CUBIC }
+};
+
+int main(int argc, char **argv) try {
+    int i,j,k,n(2000),n_grid(sizeof(G)/sizeof(G[0]));
+    double eta(5e-10), T0(10), T1(0.01), N_nu(3);
+    double T, t, T_nu, p_n, n_p, e, w;
+    for(i=1; i<argc; i++)
+        if(strcmp(argv[i],"-n")==0 && i+1<argc) n = atoi(argv[++i]);
+        else if(strcmp(argv[i],"-j")==0 && i+1<argc)
+            BBN::table_threads = MAX(1, atoi(argv[++i]));
+    std::vector<double> X_ref;
+    std::vector<std::vector<double> > F(n);// direct evaluation
+    BBN::weak = 1;
+    expansion_init(100, N_nu);// same T_zero as interp_init
+    for(i=0; i<n; i++) {// test points between grid points
+        T = T0*pow(T1/T0, (i+0.5)/n);
+        expansion(t, T_nu, T);
+        weak_rate(p_n, n_p, T, T_nu);
+        double f[] = { T, t, T_nu/T, p_n, n_p };
+        F[i].assign(f, f+5);
+    }
+    for(k=0; k<n_grid; k++) {
+        BBN::precision("standard");
+        BBN::prec.N_grid = G[k].N_grid;
+        BBN::prec.eps_grid = G[k].eps_grid;
+        BBN::prec.interp = G[k].interp;
+        stats.reset();
+        stats.on = true;
+        BBN::interp_init(T0, T1, N_nu);
+        for(i=0, e=0; i<n; i++) {
+            const std::vector<double>& f(F[i]);
+            w = f[3] + f[4];
+            e = MAX(e, fabs(BBN::expansion_time(f[0])/f[1] - 1));
+            e = MAX(e, fabs(BBN::temperature(f[1])/f[0] - 1));
+            e = MAX(e, fabs(BBN::neutrino_temperature(f[0])/f[0]/f[2] - 1));
+            e = MAX(e, fabs(BBN::proton_to_neutron(f[0]) - f[3])/w);
+            e = MAX(e, fabs(BBN::neutron_to_proton(f[0]) - f[4])/w);
+        }
+        std::vector<double> X;
+        BBN::init(eta, T0, T1, N_nu);
+        if(BBN::set_temperature(T1)) nrerror(BBN::error.c_str());
+        for(j=0; j<BBN::N_element; j++)
+            if(j != BBN::n_index) X.push_back(BBN::mass_fraction(j));
+        if(k==0) X_ref = X;
+        double e_X(0);
+        for(j=0; j<int(X.size()); j++) e_X = MAX(e_X, fabs(X[j]/X_ref[j] - 1));
+        std::cout << G[k].name << ' '
+                  << (G[k].interp == MONOTONE_CUBIC ? "pchip" : "spline")
+                  << " eps_grid=" << G[k].eps_grid
+                  << " nodes=" << BBN::x1.size()
+                  << " estimate=" << BBN::grid_error
+                  << " error=" << e
+                  << " time=" << stats.t_interp
+                  << " X_error=" << e_X << std::endl;
+    }
+    return 0;
+}
+catch(const nr_error& e) {
+    std::cerr << "grid: " << e.what() << '\n';
+    return 1;
+}
@@ -0,0 +1,147 @@
+// shifted linear systems (I - s*A)x = b for many s with same A
+// A is balanced and reduced once to upper Hessenberg form
+// H = M^{-1} D^{-1} A D M by diagonal scaling D and elimination M
+// with pivoting (W. H. Press, et al, "Numerical Recipes" section
+// 11.5), so that I - s*H is factored in O(n^2) and (I - s*A)x = b
+// is solved as x = D M (I - s*H)^{-1} M^{-1} D^{-1} b
+
+#include <cmath>
+#include "nr.h"
+using namespace std;
+
+void balanc(Mat_IO_DP &a, Vec_IO_DP &scale)
+// input: a = matrix A
+//        scale = initial guess of D, e.g. D of previous jacobian
+// output: a = D^{-1} A D
+//         scale = diagonal elements of D (powers of 2)
+// (scale factor is computed directly by exponents instead of
+//  repeated multiplication by radix, since elements of jacobian
+//  range over many orders of magnitude)
+{
+    int i,j,last=0;
+    DP r,c,f;
+
+    int n=a.nrows();
+    for (i=0;i<n;i++)
+        for (j=0;j<n;j++) a[i][j] *= scale[j]/scale[i];
+    while (last == 0) {
+        last=1;
+        for (i=0;i<n;i++) {
+            r=c=0.0;
+            for (j=0;j<n;j++)
+                if (j != i) {
+                    c += fabs(a[j][i]);
+                    r += fabs(a[i][j]);
+                }
+            if (c == 0.0 || r == 0.0) continue;
+            f=ldexp(1.0,(ilogb(r)-ilogb(c))/2);// c*f^2 ~ r
+            if (c*f+r/f < 0.95*(c+r)) {
+                last=0;
+                scale[i] *= f;
+                for (j=0;j<n;j++) a[i][j] /= f;
+                for (j=0;j<n;j++) a[j][i] *= f;
+            }
+        }
+    }
+    // D is unique up to constant factor, which is fixed so that
+    // max(D) ~ 1 lest it drift when D is reused as initial guess
+    for (f=0.0,i=0;i<n;i++) f=MAX(f,scale[i]);
+    for (f=ldexp(1.0,-ilogb(f)),i=0;i<n;i++) scale[i] *= f;
+}
+
+void elmhes(Mat_IO_DP &a, Vec_O_INT &perm, Vec_IO_DP &scale)
+// input: a = matrix A
+//        scale = initial guess of D (see balanc)
+// output: a = H on and above subdiagonal, multipliers of M below it
+//         perm = row (and column) interchanged with m at step m
+//         scale = diagonal elements of D
+{
+    int i,j,m;
+    DP y,x;
+
+    int n=a.nrows();
+    balanc(a,scale);
+    for (m=1;m<n-1;m++) {
+        x=0.0;
+        i=m;
+        for (j=m;j<n;j++) {
+            if (fabs(a[j][m-1]) > fabs(x)) {
+                x=a[j][m-1];
+                i=j;
+            }
+        }
+        perm[m]=i;
+        if (i != m) {
+            for (j=m-1;j<n;j++) SWAP(a[i][j],a[m][j]);
+            for (j=0;j<n;j++) SWAP(a[j][i],a[j][m]);
+        }
+        for (i=m+1;i<n;i++) {
+            y=a[i][m-1];
+            a[i][m-1]=0.0;
+            if (x == 0.0 || y == 0.0) continue;
+            y /= x;
+            a[i][m-1]=y;
+            for (j=m;j<n;j++) a[i][j] -= y*a[m][j];
+            for (j=0;j<n;j++) a[j][m] += y*a[j][i];
+        }
+    }
+}
+
+void hesdcmp(Mat_I_DP &h, const DP s, Mat_O_DP &b, Vec_O_INT &piv)
+// LU decomposition of I - s*H with partial pivoting
+// input: h = output of elmhes
+//        s = shift
+// output: b = L (subdiagonal) and U (upper triangle)
+//         piv[k] = 1 if rows k and k+1 are interchanged
+{
+    const DP TINY=1.0e-20;
+    int i,j,k;
+    DP m;
+
+    int n=h.nrows();
+    for (i=0;i<n;i++) {
+        for (j=0;j<n;j++)
+            b[i][j] = (j+1 < i ? 0.0 : (i==j) - s*h[i][j]);
+    }
+    for (k=0;k<n-1;k++) {
+        piv[k] = (fabs(b[k+1][k]) > fabs(b[k][k]));
+        if (piv[k])
+            for (j=k;j<n;j++) SWAP(b[k][j],b[k+1][j]);
+        if (b[k][k] == 0.0) b[k][k]=TINY;
+        m=b[k+1][k] /= b[k][k];
+        for (j=k+1;j<n;j++) b[k+1][j] -= m*b[k][j];
+    }
+    if (b[n-1][n-1] == 0.0) b[n-1][n-1]=TINY;
+}
+
+void hesbksb(Mat_I_DP &h, Vec_I_INT &perm, Vec_I_DP &scale,
+             Mat_I_DP &b, Vec_I_INT &piv, Vec_IO_DP &x)
+// solve (I - s*A)x = b
+// input: h,perm,scale = output of elmhes
+//        b,piv = output of hesdcmp
+//        x = right hand side
+// output: x = solution
+{
+    int i,j,k,m;
+    DP sum;
+
+    int n=h.nrows();
+    for (i=0;i<n;i++) x[i] /= scale[i];// x = D^{-1} x
+    for (m=1;m<n-1;m++) {// x = M^{-1} x
+        SWAP(x[perm[m]],x[m]);
+        for (i=m+1;i<n;i++) x[i] -= h[i][m-1]*x[m];
+    }
+    for (k=0;k<n-1;k++) {// x = L^{-1} x
+        if (piv[k]) SWAP(x[k],x[k+1]);
+        x[k+1] -= b[k+1][k]*x[k];
+    }
+    for (i=n-1;i>=0;i--) {// x = U^{-1} x
+        for (sum=x[i],j=i+1;j<n;j++) sum -= b[i][j]*x[j];
+        x[i]=sum/b[i][i];
+    }
+    for (m=n-2;m>0;m--) {// x = M x
+        for (i=m+1;i<n;i++) x[i] += h[i][m-1]*x[m];
+        SWAP(x[perm[m]],x[m]);
+    }
+    for (i=0;i<n;i++) x[i] *= scale[i];// x = D x
+}
@@ -0,0 +1,222 @@
+// job specification and result for batch driver (see job.h)
+
+#include<cctype>
+#include<cmath>
+#include<cstdlib>
+#include<cstring>
+#include<sstream>
+#include "job.h"
+#include "stats.h"
+#include "writer.h"
+#include "memo.h"
+#include "BBN.h"
+
+memo_store *job_memo(0);
+
+job::job() : eta(0), N_nu(3), tau(tau_n), T_init(10), T_final(0.01), eps(0), tier(0), deadline(0) {;}
+
+static void skip(const char *&s) { while(isspace(*s)) s++; }
+
+static bool parse_string(const char *&s, std::string& v)
+// parse JSON string (escapes are kept as they are)
+{
+    const char *p(s);
+    if(*s != '"') return false;
+    for(s++; *s && *s != '"'; s++) if(*s == '\\' && s[1]) s++;
+    if(*s != '"') return false;
+    v.assign(p, ++s - p);
+    return true;
+}
+
+static bool parse_number(const char *&s, double& v)
+{
+    char *e;
+    v = strtod(s, &e);
+    if(e == s) return false;
+    s = e;
+    return true;
+}
+
+bool job::parse(const std::string& line, std::string& err)
+// parse one line of JSON object; return false and set err if failed
+{
+    const char *s(line.c_str());
+    std::string key;
+    double v;
+    bool has_T(false);
+    *this = job();
+    skip(s);
+    if(*s++ != '{') { err = "expected {"; return false; }
+    for(skip(s); *s != '}';) {
+        if(!parse_string(s, key)) { err = "expected key"; return false; }
+        skip(s);
+        if(*s++ != ':') { err = "expected :"; return false; }
+        skip(s);
+        if(key == "\"id\"") {
+            if(!parse_string(s, id) && !parse_number(s, v)) { err = "bad id"; return false; }
+            if(*id.c_str() != '"') { std::ostringstream o; o << v; id = o.str(); }
+        }
+        else if(key == "\"T\"") {
+            if(*s++ != '[') { err = "expected ["; return false; }
+            for(skip(s); *s != ']';) {
+                if(!parse_number(s, v)) { err = "bad number in T"; return false; }
+                T.push_back(v);
+                skip(s);
+                if(*s == ',') s++;
+                skip(s);
+            }
+            s++;
+            has_T = true;
+        }
+        else if(key == "\"precision\"") {
+            if(!parse_string(s, key)) { err = "bad precision"; return false; }
+            for(tier=0; BBN::tier[tier].name; tier++)
+                if(key == '"' + std::string(BBN::tier[tier].name) + '"') break;
+            if(!BBN::tier[tier].name) { err = "unknown precision " + key; return false; }
+        }
+        else {
+            if(!parse_number(s, v)) { err = "bad value of " + key; return false; }
+            if(key == "\"eta\"") eta = v;
+            else if(key == "\"N_nu\"") N_nu = v;
+            else if(key == "\"tau\"") tau = v;
+            else if(key == "\"T_init\"") T_init = v;
+            else if(key == "\"T_final\"") T_final = v;
+            else if(key == "\"eps\"") eps = v;
+            else if(key == "\"deadline_ms\"") deadline = v;
+            else { err = "unknown key " + key; return false; }
+        }
+        skip(s);
+        if(*s == ',') s++;
+        else if(*s != '}') { err = "expected , or }"; return false; }
+        skip(s);
+    }
+    if(!has_T) T.push_back(T_final);
+    return check(err);
+}
+
+bool job::check(std::string& err) const
+// validate parameters; return false and set err if invalid
+{
+    if(!std::isfinite(eta) || eta <= 0) { err = "eta must be positive and finite"; return false; }
+    if(!std::isfinite(N_nu) || N_nu < 0) { err = "N_nu must be non-negative and finite"; return false; }
+    if(!std::isfinite(tau) || tau <= 0) { err = "tau must be positive and finite"; return false; }
+    if(!std::isfinite(eps) || eps < 0) { err = "eps must be non-negative and finite"; return false; }
+    if(!std::isfinite(T_init) || T_init <= T_final || T_final <= 0) { err = "bad temperature range"; return false; }
+    for(size_t i=0; i<T.size(); i++)
+        if(!std::isfinite(T[i]) || T[i] > T_init || T[i] < T_final
+           || (i && T[i] > T[i-1])) { err = "bad output temperatures"; return false; }
+    return true;
+}
+
+static void memo_text(const job& j, std::string& s)
+// list every input that affects result of run_job(j) in calling thread
+// (key of job_memo); version is to be incremented when results of
+// same inputs are changed by revision of code
+{
+    const BBN_precision& p(BBN::tier[j.tier]);
+    const double v[] = { j.eta, j.N_nu, j.tau, j.T_init, j.T_final,
+        j.eps > 0 ? j.eps : p.eps, double(p.N_quad), double(p.N_grid),
+        p.eps_grid, double(p.interp), p.eps_expansion, p.eps_jac,
+        double(BBN::log_abundance), double(BBN::nse_start),
+        double(BBN::log_temperature), BBN::qss_ratio, BBN::qss_step,
+        double(linear_solver), double(BBN::retry.n), BBN::retry.eps_factor,
+        double(BBN::retry.toggle_log), double(BBN::N_element),
+        double(BBN::N_reaction) };
+    size_t i;
+    s = "bbn 1";// version
+    for(i=0; i<sizeof(v)/sizeof(v[0]); i++) { s += ' '; put(s, v[i]); }
+    s += " T";
+    for(i=0; i<j.T.size(); i++) { s += ' '; put(s, j.T[i]); }
+}
+
+bool recall_job(const job& j, job_result& r)
+// if result of j is in job_memo, set it to r and return true
+{
+    if(!job_memo) return false;
+    std::string s;
+    double t0(solver_stats::clock());
+    memo_text(j, s);
+    if(!job_memo->get(s, r.X) || r.X.size() != j.T.size()*BBN::N_element)
+        return false;
+    r.id = j.id;
+    r.error.clear();
+    r.retries = 0;
+    r.T = j.T;
+    r.wall = solver_stats::clock() - t0;
+    return true;
+}
+
+void run_job(const job& j, job_result& r, double deadline)
+// integrate network for job j in calling thread
+// (interpolation tables of the thread are reused if possible)
+// deadline = solver_stats::clock() at which job is abandoned (0 if none);
+//   it is checked before each output temperature
+// errors of solver (after retries by BBN::retry) are set to r.error;
+// result is saved to job_memo if it is used (see recall_job)
+{
+    size_t i,k;
+    double t0(solver_stats::clock());
+    r.id = j.id;
+    r.error.clear();
+    r.retries = 0;
+    r.T = j.T;
+    r.X.resize(j.T.size()*BBN::N_element);
+    BBN::precision(BBN::tier[j.tier].name);
+    try { BBN::init(j.eta, j.T_init, j.T_final, j.N_nu, j.tau); }
+    catch(const nr_error& e) { r.error = e.what(); }
+    if(j.eps > 0) BBN::eps = j.eps;
+    for(i=0; i<j.T.size() && r.error.empty(); i++) {
+        if(deadline && solver_stats::clock() > deadline) {
+            r.error = "deadline exceeded";
+            break;
+        }
+        if(BBN::set_temperature(j.T[i])) r.error = BBN::error;
+        r.retries += BBN::retries;
+        for(k=0; k<size_t(BBN::N_element); k++)
+            r.X[i*BBN::N_element + k] = BBN::mass_fraction(k);
+    }
+    r.wall = solver_stats::clock() - t0;
+    if(job_memo && r.error.empty()) {
+        std::string s;
+        memo_text(j, s);
+        job_memo->put(s, r.X);
+    }
+}
+
+void job_result::format(std::string& s) const
+// append result to s as one line of JSON
+// (numbers in shortest form that is read back exactly)
+{
+    size_t i,k,n(BBN::N_element);
+    s += "{\"id\": ";
+    s += (id.size() ? id : "null");
+    if(error.size()) {
+        s += ", \"error\": \"";
+        for(i=0; i<error.size(); i++) {
+            if(error[i]=='"' || error[i]=='\\') s += '\\';
+            s += error[i];
+        }
+        s += "\"}\n";
+        return;
+    }
+    s += ", \"T\": [";
+    for(i=0; i<T.size(); i++) { if(i) s += ", "; put(s, T[i]); }
+    s += "], \"X\": [";
+    for(i=0; i<T.size(); i++) {
+        s += (i ? ", [" : "[");
+        for(k=0; k<n; k++) { if(k) s += ", "; put(s, X[i*n + k]); }
+        s += ']';
+    }
+    s += "], \"wall\": ";
+    put(s, wall);
+    if(retries) { s += ", \"retries\": "; put(s, long(retries)); }
+    s += "}\n";
+}
+
+void job_result::print(std::ostream& o) const
+// print result as one line of JSON
+{
+    std::string s;
+    format(s);
+    o << s << std::flush;
+}
@@ -0,0 +1,53 @@
+// job specification and result for batch driver
+//
+// job is one line of JSON object, e.g.
+//   {"id": "a1", "eta": 6e-10, "N_nu": 3, "tau": 880,
+//    "T_init": 10, "T_final": 0.01, "T": [1, 0.1, 0.01], "eps": 1e-6,
+//    "precision": "standard"}
+// every key but eta is optional (defaults as in BBN::init);
+// precision = name of tier (see BBN::precision); eps overrides its eps;
+// T = list of output temperatures / MeV (default [T_final]);
+// "deadline_ms" is used only by bbnd
+
+#ifndef __job_h__
+#define __job_h__
+
+#include<string>
+#include<vector>
+#include<iostream>
+
+struct job {
+    std::string id;// JSON text of id (string or number)
+    double eta;// baryon to photon ratio
+    double N_nu;// number of neutrino generation
+    double tau;// neutron lifetime / sec
+    double T_init;// initial temperature / MeV
+    double T_final;// final temperature / MeV
+    double eps;// error tolerance (0 if given by precision)
+    int tier;// index of precision tier in BBN::tier
+    double deadline;// time limit from arrival / msec (0 if none)
+    std::vector<double> T;// output temperatures / MeV
+    job();
+    bool parse(const std::string& line, std::string& err);
+    bool check(std::string& err) const;
+};
+
+struct job_result {
+    std::string id;
+    std::string error;// empty if succeeded
+    int retries;// number of retries after solver errors (see BBN::retry)
+    std::vector<double> T;// output temperatures / MeV
+    std::vector<double> X;// mass fractions (T.size() x N_element)
+                          // in the order of BBN::element
+    double wall;// wall time / sec
+    void format(std::string&) const;
+    void print(std::ostream&) const;
+};
+
+struct memo_store;// see memo.h
+extern memo_store *job_memo;// store of results (0 if not used)
+
+void run_job(const job&, job_result&, double=0);
+bool recall_job(const job&, job_result&);
+
+#endif // __job_h__
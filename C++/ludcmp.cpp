@@ -18,7 +18,7 @@ void ludcmp(Mat_IO_DP &a, Vec_O_INT &indx, DP &d)
         big=0.0;
         for (j=0;j<n;j++)
             if ((temp=fabs(a[i][j])) > big) big=temp;
-        if (big == 0.0) nrerror("Singular matrix in routine ludcmp");
+        if (big == 0.0) nrerror("Singular matrix in routine ludcmp",NR_SINGULAR);
         vv[i]=1.0/big;
     }
     for (j=0;j<n;j++) {
@@ -0,0 +1,119 @@
+// persistent store of results keyed by text of inputs (see memo.h)
+
+#include<cstdio>
+#include<cstring>
+#include<algorithm>
+#include<dirent.h>
+#include<unistd.h>
+#include<sys/stat.h>
+#include<sys/time.h>
+#include "memo.h"
+
+unsigned long long fnv1a(const std::string& s)
+// 64-bit FNV-1a hash of s
+{
+    unsigned long long h(14695981039346656037ULL);
+    for(size_t i=0; i<s.size(); i++) {
+        h ^= (unsigned char)s[i];
+        h *= 1099511628211ULL;
+    }
+    return h;
+}
+
+memo_store::memo_store(const char *d, long m)
+    : dir(d), max_bytes(m), hits(0), misses(0), stores(0), evictions(0), size(0)
+{
+    mkdir(d, 0777);// (fails if exists)
+    evict();// measure size
+}
+
+std::string memo_store::path(const std::string& text) const
+{
+    char b[24];
+    snprintf(b, sizeof(b), "%016llx", fnv1a(text));
+    return dir + '/' + b + ".memo";
+}
+
+bool memo_store::get(const std::string& text, std::vector<double>& v)
+// if text is in store, set v to saved values and return true
+{
+    std::string p(path(text)), t;
+    FILE *fp(fopen(p.c_str(), "rb"));
+    char magic[4];
+    int n(-1);
+    bool ok(fp && fread(magic, 4, 1, fp) == 1 && memcmp(magic, "BBNM", 4) == 0
+            && fread(&n, sizeof(n), 1, fp) == 1 && n == int(text.size()));
+    if(ok) {
+        t.resize(n);
+        ok = (fread(&t[0], 1, n, fp) == size_t(n) && t == text
+              && fread(&n, sizeof(n), 1, fp) == 1 && n >= 0);
+    }
+    if(ok) {
+        v.resize(n);
+        ok = (fread(v.data(), sizeof(double), n, fp) == size_t(n));
+    }
+    if(fp) fclose(fp);
+    if(!ok) { misses++; return false; }
+    utimes(p.c_str(), 0);// for eviction of least recently used
+    hits++;
+    return true;
+}
+
+void memo_store::put(const std::string& text, const std::vector<double>& v)
+// save v for text (atomically replaced if exists)
+{
+    std::string p(path(text)), q(p + ".XXXXXX");
+    int fd(mkstemp(&q[0]));
+    if(fd < 0) return;
+    FILE *fp(fdopen(fd, "wb"));
+    int n(text.size()), m(v.size());
+    bool ok(fp && fwrite("BBNM", 4, 1, fp) == 1
+            && fwrite(&n, sizeof(n), 1, fp) == 1
+            && fwrite(text.data(), 1, n, fp) == size_t(n)
+            && fwrite(&m, sizeof(m), 1, fp) == 1
+            && fwrite(v.data(), sizeof(double), m, fp) == size_t(m));
+    if(fp) ok &= (fclose(fp) == 0);
+    else close(fd);
+    if(!ok || rename(q.c_str(), p.c_str())) { unlink(q.c_str()); return; }
+    stores++;
+    if((size += 12 + n + 8*m) > max_bytes) evict();
+}
+
+void memo_store::evict()
+// measure total size of entries (including those by other processes),
+// and remove least recently used entries if it exceeds max_bytes
+{
+    std::lock_guard<std::mutex> l(lock);
+    // entries of (mtime, (size, path))
+    std::vector<std::pair<double, std::pair<long, std::string> > > e;
+    long total(0);
+    DIR *d(opendir(dir.c_str()));
+    if(!d) return;
+    for(struct dirent *f; (f = readdir(d));) {
+        size_t k(strlen(f->d_name));
+        struct stat s;
+        if(k < 5 || strcmp(f->d_name + k - 5, ".memo")) continue;
+        std::string p(dir + '/' + f->d_name);
+        if(stat(p.c_str(), &s)) continue;
+        double t(s.st_mtim.tv_sec + 1e-9*s.st_mtim.tv_nsec);
+        e.push_back(std::make_pair(t, std::make_pair(long(s.st_size), p)));
+        total += s.st_size;
+    }
+    closedir(d);
+    if(total > max_bytes) {
+        std::sort(e.begin(), e.end());
+        for(size_t i=0; i<e.size() && total > max_bytes*0.9; i++) {
+            if(unlink(e[i].second.second.c_str())) continue;
+            total -= e[i].second.first;
+            evictions++;
+        }
+    }
+    size = total;
+}
+
+void memo_store::print(std::ostream& o) const
+{
+    o << "memo " << dir << ": hits " << hits << ", misses " << misses
+      << ", stores " << stores << ", evictions " << evictions
+      << ", bytes " << size << '\n';
+}
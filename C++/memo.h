@@ -0,0 +1,39 @@
+// persistent store of results keyed by text of inputs
+//
+// entry is file <dir>/<hash>.memo, where hash = FNV-1a (64 bit, in 16
+// hex digits) of text that lists every input affecting the result
+// (see memo_text in job.cpp); text is also saved in entry and compared
+// on lookup, so that collision of hash never gives wrong result;
+// entries are written to temporary file and renamed, so that processes
+// sharing dir never see partial entries; when total size of entries
+// exceeds max_bytes, least recently used entries (by mtime, which is
+// touched on hit) are removed until size is below 90% of max_bytes
+// file layout: "BBNM", int32 length of text, text, int32 n, double[n]
+
+#ifndef __memo_h__
+#define __memo_h__
+
+#include<atomic>
+#include<iostream>
+#include<mutex>
+#include<string>
+#include<vector>
+
+unsigned long long fnv1a(const std::string&);
+
+struct memo_store {
+    std::string dir;// directory of entries
+    long max_bytes;// bound of total size of entries
+    std::atomic<long> hits, misses, stores, evictions;
+    memo_store(const char *dir, long max_bytes=1L<<30);
+    bool get(const std::string& text, std::vector<double>& v);
+    void put(const std::string& text, const std::vector<double>& v);
+    void evict();
+    void print(std::ostream&) const;
+private:
+    std::atomic<long> size;// total size of entries / bytes (estimate)
+    std::mutex lock;// for evict
+    std::string path(const std::string& text) const;
+};
+
+#endif // __memo_h__
@@ -0,0 +1,6 @@
+// empty lists of baked tables (see baked.h)
+
+#include "baked.h"
+
+extern const baked_quadrature baked_quad[] = { { 0 } };
+extern const baked_table baked_tables[] = { { 0 } };
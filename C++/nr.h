@@ -4,6 +4,7 @@
 #include<cstdlib>
 #include<string>
 #include<iostream>
+#include<stdexcept>
 
 #include "Vec.h"
 #include "Mat.h"
@@ -25,7 +26,24 @@ inline const T MAX(const T &a, const T &b)
 template<class T>
 inline const T SQR(const T a) {return a*a;}
 
-inline void nrerror(const char *s)
-{ std::cerr << s << std::endl; exit(1); }
+template<class T>
+inline void SWAP(T &a, T &b)
+{T dum=a; a=b; b=dum;}
+
+// status of errors in numerical routines (nr_error::status)
+enum { NR_FAILED=1,// other errors
+       NR_SINGULAR,// singular matrix
+       NR_TOO_MANY_STEPS,// too many steps in odeint
+       NR_STEP_TOO_SMALL,// step size underflow
+       NR_NO_CONVERGENCE,// iteration does not converge
+       NR_BAD_INPUT };// bad input to routine
+
+struct nr_error : std::runtime_error {// thrown by nrerror
+    int status;
+    nr_error(const char *s, int st) : std::runtime_error(s), status(st) {}
+};
+
+inline void nrerror(const char *s, int status=NR_FAILED)
+{ throw nr_error(s, status); }
 
 #endif // __nr_h__
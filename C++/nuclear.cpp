@@ -1,6 +1,8 @@
 // configure nuclear reactions
 
+#include<algorithm>
 #include<cmath>
+#include "stats.h"
 #include "BBN.h"
 
 particle::particle(double m, int s, const char *n)
@@ -103,13 +105,20 @@ void BBN::reaction_rate(Vec_DP& r, double T)
 
 int BBN::N_element(N);// number of elements synthesized
 int BBN::N_reaction(M);// number of reactions
-int BBN::n_index(-1);// index of neutron
-int BBN::p_index(-1);// index of proton
-Mat_INT BBN::index(-1,M,4);// table of particles
-Vec_DP BBN::y(N);// abundance of elements (dependent variable)
+thread_local int BBN::n_index(-1);// index of neutron
+thread_local int BBN::p_index(-1);// index of proton
+thread_local Mat_INT BBN::index(-1,M,4);// table of particles
+thread_local Vec_DP BBN::y(N);// abundance of elements (dependent variable)
 
-static Vec_DP bind(M);// binding energy / MeV
-static Vec_DP balance(M);// balancing factor
+static thread_local Vec_DP bind(M);// binding energy / MeV
+static thread_local Vec_DP balance(M);// balancing factor
+
+// elements in nuclear statistical equilibrium (NSE) are derived from
+// n and p through chain of reactions in equilibrium
+static thread_local Vec_INT Z(N), Nn(N);// number of protons and neutrons
+static thread_local Vec_INT chain(N);// chain[k] = reaction deriving element k
+static thread_local Vec_INT order(N);// order of derivation
+static thread_local int n_order(0);// number of derived elements
 
 void BBN::reaction_init()
 {
@@ -117,14 +126,14 @@ void BBN::reaction_init()
     int i,j,k;
     double m[4],g[4];
     
-    if(n_index>=0) return;// execute only once
+    if(n_index>=0) return;// execute only once (in each thread)
     // search proton and neutron in elements
     for(i=0; i<N; i++) {
         if(element[i] == neutron) n_index = i;
         else if(element[i] == proton) p_index = i;
         if(p_index>=0 && n_index>=0) break;
     }
-    if(i==N) nrerror("proton or neutron absent");
+    if(i==N) nrerror("proton or neutron absent",NR_BAD_INPUT);
     
     // precompute binding energy and balancing factor
     for(i=0; i<M; i++) {
@@ -143,6 +152,126 @@ void BBN::reaction_init()
         else
             balance[i] = g[0]*g[1]/g[2]/g[3]*pow(m[0]*m[1]/m[2]/m[3], 1.5);
     }
+
+    // find reactions deriving each element from n and p
+    Z = -1;
+    Z[n_index] = 0; Nn[n_index] = 1;
+    Z[p_index] = 1; Nn[p_index] = 0;
+    for(n_order=0, k=1; k;) {
+        for(i=k=0; i<M; i++) {
+            int u(-1), n_u(0), z(0), n(0);
+            const int *id(index[i]);
+            for(j=0; j<4; j++) {
+                if(id[j] < 0) continue;
+                if(Z[id[j]] < 0) { u = j; n_u++; continue; }
+                z += (j<2 ? 1 : -1)*Z[id[j]];
+                n += (j<2 ? 1 : -1)*Nn[id[j]];
+            }
+            if(n_u != 1) continue;
+            Z[id[u]] = (u<2 ? -z : z);// conservation of charge
+            Nn[id[u]] = (u<2 ? -n : n);// and of baryon number
+            chain[id[u]] = i;
+            order[n_order++] = id[u];
+            k++;
+        }
+    }
+}
+
+static void nse_lny(Vec_DP& lny, double a, double b, double lnN, double T)
+// logarithm of NSE abundances
+// input: a,b = ln(y) of free neutron and proton
+//        lnN = ln(number density of nucleons / cm^-3)
+//        T = temperature / MeV
+// output: lny = ln(y) of elements
+{
+    int i,j,k,l;
+    double lnX[4], lnK;
+    lny[BBN::n_index] = a;
+    lny[BBN::p_index] = b;
+    for(l=0; l<n_order; l++) {
+        k = order[l];
+        i = chain[k];
+        const int *id(BBN::index[i]);
+        // lnK = ln(X2*X3/X0/X1) in equilibrium (cf. reaction_rate)
+        lnK = bind[i]/T - log(balance[i]);
+        if(id[3] < 0 || id[2] < 0) lnK -= 1.5*log(T);
+        for(j=0; j<4; j++)
+            lnX[j] = (id[j]<0 || id[j]==k ? 0 : lnN + lny[id[j]]);
+        for(j=0; id[j]!=k; j++);
+        if(j<2) lny[k] = lnX[2] + lnX[3] - lnX[j^1] - lnK - lnN;
+        else    lny[k] = lnX[0] + lnX[1] - lnX[j^1] + lnK - lnN;
+    }
+}
+
+void BBN::nse(double T, double Yn, double Yp)
+// set y to nuclear statistical equilibrium (Kolb & Turner eq.4.11)
+// T = temperature / MeV
+// Yn,Yp = total number of neutrons and protons (free or bound)
+//         per nucleon
+{
+    const int MAXIT(100);
+    int i,k;
+    double lnN, a(log(Yn)), b(log(Yp)), F1, F2, J11, J12, J22, D, da, db;
+    Vec_DP lny(N);
+    reaction_init();
+    if(n_order < N-2) nrerror("NSE is not defined for some elements",NR_BAD_INPUT);
+    lnN = log(n0*pow(neutrino_temperature(T), 3));
+    for(i=0; i<MAXIT; i++) {// Newton iteration on ln(y) of free n and p
+        nse_lny(lny, a, b, lnN, T);
+        F1 = -Yn; F2 = -Yp;
+        J11 = J12 = J22 = 0;
+        for(k=0; k<N; k++) {
+            y[k] = exp(MIN(lny[k], 0.));
+            F1 += Nn[k]*y[k];
+            F2 += Z[k]*y[k];
+            J11 += Nn[k]*Nn[k]*y[k];
+            J12 += Nn[k]*Z[k]*y[k];
+            J22 += Z[k]*Z[k]*y[k];
+        }
+        D = J11*J22 - J12*J12;
+        da = -(J22*F1 - J12*F2)/D;
+        db = -(J11*F2 - J12*F1)/D;
+        a += MAX(-1., MIN(1., da));
+        b += MAX(-1., MIN(1., db));
+        if(fabs(da) < 1e-12 && fabs(db) < 1e-12) return;
+    }
+    nrerror("NSE iteration does not converge",NR_NO_CONVERGENCE);
+}
+
+double BBN::nse_temperature(double T_init, double T_final, double G)
+// temperature below which NSE is no longer maintained, i.e.
+// highest temperature at which rate of reactions involving
+// some element is less than G times expansion rate
+// T_init,T_final = range of search / MeV
+// return T_final if NSE is maintained throughout the range
+// (init must be called beforehand)
+{
+    static double Q(mn-mp);// mass difference of neutron and proton
+    int i,j,k;
+    double T,H,N_,F,Yn;
+    Vec_DP r1(M), r2(M), R(N);
+    Vec_DP y_(y);
+    for(T=T_init; T>T_final; T*=0.98) {
+        Yn = 1/(exp(Q/T) + 1);// weak equilibrium
+        nse(T, Yn, 1-Yn);
+        reaction_rate(r1, r2, T);
+        H = expansion_rate(T, neutrino_temperature(T));
+        N_ = n0*pow(neutrino_temperature(T), 3);
+        R = 0;
+        for(i=0; i<M; i++) {
+            if(r1[i] <= 0) continue;// fit is out of range
+            // forward and reverse flux are equal in equilibrium
+            for(j=0, F=r1[i]; j<2; j++)
+                if(index[i][j] >= 0) F *= N_*y[index[i][j]];
+            for(j=0; j<4; j++)
+                if(index[i][j] >= 0) R[index[i][j]] += F;
+        }
+        for(k=0; k<N; k++)
+            if(k != n_index && k != p_index && R[k] < G*H*N_*y[k]) break;
+        if(k < N) break;
+    }
+    y = y_;
+    return MAX(T, T_final);
 }
 
 void BBN::reaction_rate(Vec_DP& r1, Vec_DP& r2, double T)
@@ -158,4 +287,227 @@ void BBN::reaction_rate(Vec_DP& r1, Vec_DP& r2, double T)
         if(index[i][3] < 0 || index[i][2] < 0)
             r2[i] *= T32;// in case of photon creation
     }
-}
\ No newline at end of file
+}
+// quasi-steady state (QSS): element k (except n and p) is in QSS while
+// its destruction rate exceeds qss_ratio times expansion rate, i.e.
+// its lifetime is much shorter than expansion time, its net rate
+// |dy_k/dt| is below 1/qss_ratio of destruction, and estimated error
+// of QSS is below 1/qss_ratio (see qss_select); then dy_k/dt = 0
+// is imposed as algebraic constraint, and stiff solver integrates
+// slow variables z only, where z of n and p are total numbers of
+// neutrons and protons (free or bound in elements in QSS) per nucleon
+// (as in weak_eq before hand-off from NSE), so that baryon number is
+// conserved; y of n, p and elements in QSS are solved from z by
+// Newton iteration; elements in QSS are selected at each interval of
+// temperature by factor qss_step, during which they are fixed;
+// max relative error of mass fractions vs reference tier (fig5-6 -q,
+// eta=5e-10) is 2e-3 for qss_ratio=1e3 and 1.5e-4 for 1e4, where that
+// of stiff solution is 1.4e-4 (checked by make check)
+thread_local double BBN::qss_ratio(0);
+thread_local double BBN::qss_step(1.05);
+static thread_local std::vector<int> F, S;// elements in QSS and others
+static thread_local Vec_DP y_qss;// y of last solution of constraints
+
+void ludcmp(Mat_DP &a, Vec_INT &indx, double &d);
+void lubksb(const Mat_DP &a, const Vec_INT &indx, Vec_DP &b);
+
+static void qss_select(double t, const Vec_DP& y)
+// set elements in QSS (F) and others (S) at time t
+{
+    int i,j,k,m;
+    double d,e,T(BBN::temperature(t)), T_nu(BBN::neutrino_temperature(T));
+    double Nb(BBN::n0*pow(T_nu, 3)), H(expansion_rate(T, T_nu));
+    Vec_DP r1(M), r2(M), D(0., N), f(N), fx(N);
+    Mat_DP fy(N,N);
+    BBN::reaction_rate(r1, r2, T);
+    BBN::diff_eq(t, y, f);
+    stats.rhs++;
+    for(i=0; i<M; i++) {// destruction rate / sec^-1
+        const int *id(BBN::index[i]);
+        for(j=0; j<4; j++) {
+            if(id[j] < 0) continue;
+            k = id[j^1];
+            D[id[j]] += (j<2 ? r1[i] : r2[i])*(k<0 ? 1 : Nb*y[k]);
+        }
+    }
+    F.clear();
+    S.clear();
+    for(k=0; k<N; k++)
+        if(k != BBN::n_index && k != BBN::p_index && Z[k] >= 0
+           && D[k] > BBN::qss_ratio*H
+           && fabs(f[k])*BBN::qss_ratio < D[k]*y[k]) F.push_back(k);
+        else S.push_back(k);
+    if(F.empty()) return;
+    // a posteriori check: QSS error of y_F is dy = J^-1 dy_F/dt, where
+    // J = df_F/dy_F and dy_F/dt = -J^-1 (df_F/dy_S f_S + df_F/dt) on
+    // constraints f_F = 0; element is removed from F while relative
+    // error of y_F, or error df_S/dy_F dy of net rate f_S (relative to
+    // |f_S| + H y_S), exceeds 1/qss_ratio; latter excludes e.g. He3,
+    // which is fast by itself, but T(p,n)He3 and He3(n,p)T nearly
+    // cancel in f of T, so that error of f of T is amplified
+    BBN::jac(t, y, fx, fy);
+    stats.jac++;
+    while((m = F.size())) {
+        Mat_DP a(m,m);
+        Vec_DP b(m);
+        Vec_INT indx(m);
+        for(i=0; i<m; i++)
+            for(j=0; j<m; j++) a[i][j] = fy[F[i]][F[j]];
+        ludcmp(a,indx,d);
+        stats.lu++;
+        for(i=0; i<m; i++) {
+            b[i] = fx[F[i]];
+            for(int s: S) b[i] += fy[F[i]][s]*f[s];
+        }
+        lubksb(a,indx,b);
+        lubksb(a,indx,b);// b = -dy
+        for(i=k=0, e=0; i<m; i++)
+            if(fabs(b[i]) > e*y[F[i]]) { e = fabs(b[i])/y[F[i]]; k = i; }
+        for(int s: S) {
+            for(i=0, d=0; i<m; i++) d += fy[s][F[i]]*b[i];
+            if(fabs(d) <= e*(fabs(f[s]) + H*y[s])) continue;
+            e = fabs(d)/(fabs(f[s]) + H*y[s]);
+            for(i=0, d=0; i<m; i++)// element of largest error of f_s
+                if(fabs(fy[s][F[i]]*b[i]) > d) { d = fabs(fy[s][F[i]]*b[i]); k = i; }
+        }
+        if(e*BBN::qss_ratio < 1) break;
+        S.insert(std::upper_bound(S.begin(), S.end(), F[k]), F[k]);
+        F.erase(F.begin() + k);
+    }
+}
+
+static void qss_slow(const Vec_DP& y, Vec_DP& z)
+// slow variables z of abundance y, or (as it is linear) time derivative
+// z of slow variables given y = dy/dt (f_k of elements in QSS are
+// included in z of n and p, which is exact even if f_k is not zero,
+// e.g. in jacobian)
+{
+    for(int i=0; i<int(S.size()); i++) {
+        z[i] = y[S[i]];
+        for(int k: F)
+            if(S[i] == BBN::n_index) z[i] += Nn[k]*y[k];
+            else if(S[i] == BBN::p_index) z[i] += Z[k]*y[k];
+    }
+}
+
+static void qss_matrix(const Mat_DP& fy, Mat_DP& a)
+// jacobian of constraints with respect to y of n, p and elements in QSS
+// (in this order), i.e. f_k = 0 for k in F and definition of z of n, p
+{
+    int i,j,n(F.size()),u[2]={BBN::n_index,BBN::p_index};
+    for(i=0; i<n; i++) {
+        for(j=0; j<2; j++) a[i][j] = fy[F[i]][u[j]];
+        for(j=0; j<n; j++) a[i][j+2] = fy[F[i]][F[j]];
+    }
+    a[n][0] = 1; a[n][1] = 0;
+    a[n+1][0] = 0; a[n+1][1] = 1;
+    for(j=0; j<n; j++) {
+        a[n][j+2] = Nn[F[j]];
+        a[n+1][j+2] = Z[F[j]];
+    }
+}
+
+static void qss_solve(double t, const Vec_DP& z, Vec_DP& y)
+// solve constraints for y of n, p and elements in QSS by Newton iteration
+// input: z = slow variables, y = initial guess
+// output: y = abundance
+// (evaluations in iteration are counted in stats)
+{
+    const int MAXIT(50);
+    int i,k,n(F.size()),m(S.size()),u[2]={BBN::n_index,BBN::p_index};
+    double d,e,x;
+    Vec_DP f(N), fx, b(n+2), w(m);
+    Mat_DP fy(N,N), a(n+2,n+2);
+    Vec_INT indx(n+2);
+    for(i=0; i<m; i++) if(S[i] != u[0] && S[i] != u[1]) y[S[i]] = z[i];
+    for(k=0; k<MAXIT; k++) {
+        BBN::diff_eq(t,y,f);
+        BBN::jac(t,y,fx,fy);
+        stats.rhs++;
+        stats.jac++;
+        stats.lu++;
+        qss_matrix(fy, a);
+        qss_slow(y, w);
+        for(i=0; i<n; i++) b[i] = -f[F[i]];
+        for(i=0; i<m; i++)
+            if(S[i] == u[0]) b[n] = z[i] - w[i];
+            else if(S[i] == u[1]) b[n+1] = z[i] - w[i];
+        ludcmp(a,indx,d);
+        lubksb(a,indx,b);
+        for(i=0, e=0; i<n+2; i++) {
+            x = y[i<2 ? u[i] : F[i-2]];
+            d = MAX(x + b[i], x/10);// stay positive
+            e = MAX(e, fabs(d - x)/(x + 1e-30));
+            y[i<2 ? u[i] : F[i-2]] = d;
+        }
+        if(e < 1e-12) return;
+    }
+    nrerror("QSS iteration does not converge", NR_NO_CONVERGENCE);
+}
+
+static void diff_eq_qss(double t, const Vec_DP& z, Vec_DP& g)
+// right hand side of slow variables z
+{
+    Vec_DP f(N);
+    qss_solve(t, z, y_qss);
+    BBN::diff_eq(t, y_qss, f);
+    qss_slow(f, g);
+}
+
+static void jac_qss(double t, const Vec_DP& z, Vec_DP& gx, Mat_DP& gy)
+// jacobian of diff_eq_qss, where y of n, p and elements in QSS
+// depend on z and t through constraints
+{
+    int i,j,k,n(F.size()),m(S.size()),u[2]={BBN::n_index,BBN::p_index};
+    double d;
+    Vec_DP fx(N), b(n+2), v(N), g(m);
+    Mat_DP fy(N,N), a(n+2,n+2);
+    Vec_INT indx(n+2);
+    qss_solve(t, z, y_qss);
+    BBN::jac(t, y_qss, fx, fy);
+    qss_matrix(fy, a);
+    ludcmp(a,indx,d);
+    stats.lu++;
+    for(j=0; j<=m; j++) {
+        // v = dy/dz_j (or dy/dt if j == m) with constraints satisfied
+        v = 0.;
+        for(i=0; i<n; i++)
+            b[i] = -(j==m ? fx[F[i]] : S[j]==u[0] || S[j]==u[1] ? 0 : fy[F[i]][S[j]]);
+        b[n] = (j<m && S[j]==u[0]);
+        b[n+1] = (j<m && S[j]==u[1]);
+        lubksb(a,indx,b);
+        for(i=0; i<n+2; i++) v[i<2 ? u[i] : F[i-2]] = b[i];
+        if(j<m && S[j]!=u[0] && S[j]!=u[1]) v[S[j]] = 1;
+        // g = df/dz_j (or df/dt) projected to slow variables
+        Vec_DP h(N);
+        for(i=0; i<N; i++) {
+            for(k=0, d=(j==m ? fx[i] : 0); k<N; k++) d += fy[i][k]*v[k];
+            h[i] = d;
+        }
+        qss_slow(h, g);
+        for(i=0; i<m; i++)
+            if(j<m) gy[i][j] = g[i]; else gx[i] = g[i];
+    }
+}
+
+void BBN::integrate_qss(double t1, double t2)
+// integrate network from time t1 to t2 with elements in QSS
+{
+    extern thread_local double h_resume, h_last;// see odeint.cpp
+    double t, T;
+    for(t=t1; t<t2; t=T) {
+        T = MIN(t2, expansion_time(temperature(t)/qss_step));
+        qss_select(t, y);
+        if(t > t1) h_resume = h_last;// continue step size of last segment
+        if(F.empty()) {
+            odeint(y, diff_eq, jac, t, T, eps);
+            continue;
+        }
+        Vec_DP z(S.size());
+        qss_slow(y, z);
+        y_qss = y;
+        odeint(z, diff_eq_qss, jac_qss, t, T, eps);
+        qss_solve(T, z, y_qss);
+        y = y_qss;
+    }
+}
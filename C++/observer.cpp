@@ -0,0 +1,63 @@
+// recorders of network integration (see observer.h)
+
+#include<cmath>
+#include<algorithm>
+#include "observer.h"
+#include "BBN.h"
+
+thread_local step_observer *BBN::observer(0);// called on accepted steps
+
+step_recorder::step_recorder(int size)
+: width(2 + BBN::N_element), capacity(MAX(size,1)), n(0), buf(capacity*width) {;}
+
+void step_recorder::push(const step_view& s)
+{
+    double *p(&buf[n++*width]);
+    p[0] = s.t;
+    p[1] = s.T;
+    for(int i=2; i<width; i++) p[i] = s.y[i-2];
+}
+
+decimating_recorder::decimating_recorder(int size, int s)
+: step_recorder(MAX(size,2)), stride(MAX(s,1)), count(0), stride0(stride) {;}
+
+void decimating_recorder::clear()
+{
+    n = 0;
+    count = 0;
+    stride = stride0;
+}
+
+void decimating_recorder::observe(const step_view& s)
+{
+    if(count++ % stride) return;
+    if(n == capacity) {// keep records of even index
+        for(int i=0; i<n; i+=2)
+            std::copy(&buf[i*width], &buf[(i+1)*width], &buf[i/2*width]);
+        n = (n+1)/2;
+        stride *= 2;
+        if((count-1) % stride) return;
+    }
+    push(s);
+}
+
+log_recorder::log_recorder(double T_init, double T_final, int n)
+: step_recorder(n), T_next(T_init),
+  factor(n > 1 ? pow(T_final/T_init, 1./(n-1)) : 0), T_init(T_init)
+{
+    if(!(T_final > 0 && T_final < T_init))
+        nrerror("log_recorder: T_final must be in (0, T_init)");
+}
+
+void log_recorder::clear()
+{
+    n = 0;
+    T_next = T_init;
+}
+
+void log_recorder::observe(const step_view& s)
+{
+    if(s.T > T_next || n == capacity) return;
+    push(s);
+    while(T_next >= s.T) T_next *= factor;// skip crossed temperatures
+}
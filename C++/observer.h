@@ -0,0 +1,71 @@
+// observation of network integration on every accepted step
+//
+// set BBN::observer to an object derived from step_observer, then
+// observe(s) is called after each accepted step of set_temperature
+// with view s of solver state (no copy is made, so s is valid only
+// during the call); recorders below store (t, T, y) in buffers
+// allocated beforehand, e.g.
+//   log_recorder r(10, 0.01, 256);
+//   BBN::observer = &r;
+//   BBN::set_temperature(0.01);
+//   BBN::observer = 0;
+//   for(i=0; i<r.n; i++) ... r.record(i)[0] (time), [1] (T), [2+k] (y[k])
+// steps before hand-off from NSE (see BBN::nse_start) are not observed
+
+#ifndef __observer_h__
+#define __observer_h__
+
+#include<vector>
+#include "nr.h"
+
+struct step_view {// state after accepted step
+    double t;// time / sec
+    double T;// temperature / MeV
+    const Vec_DP& y;// abundances of elements
+    double h;// step size / sec
+    int order;// number of columns of extrapolation in stifbs
+};
+
+struct step_observer {
+    virtual void observe(const step_view&) = 0;
+    virtual ~step_observer() {;}
+};
+
+struct step_recorder : step_observer {// records of (t, T, y)
+    int width;// number of values in a record (2 + N_element)
+    int capacity;// max number of records
+    int n;// number of records
+    std::vector<double> buf;// records (capacity x width)
+    step_recorder(int capacity);
+    const double *record(int i) const { return &buf[i*width]; }
+    virtual void clear() { n = 0; }// for another integration
+protected:
+    void push(const step_view&);
+};
+
+struct decimating_recorder : step_recorder {
+    // record every stride-th step; when buffer is full, every other
+    // record is dropped and stride is doubled, so that records span
+    // whole integration at uniform interval of steps
+    int stride;
+    long count;// number of steps observed
+    decimating_recorder(int capacity, int stride=1);
+    void observe(const step_view&);
+    void clear();
+private:
+    int stride0;// initial stride
+};
+
+struct log_recorder : step_recorder {
+    // record first step at or below each of n temperatures spaced
+    // logarithmically from T_init to T_final (0 < T_final < T_init)
+    double T_next;// next temperature to be recorded
+    double factor;// ratio of successive temperatures
+    log_recorder(double T_init, double T_final, int n);
+    void observe(const step_view&);
+    void clear();
+private:
+    double T_init;
+};
+
+#endif // __observer_h__
@@ -3,6 +3,7 @@
 
 #include<cmath>
 #include "nr.h"
+#include "stats.h"
 using namespace std;
 
 void rkck(Vec_I_DP &y, Vec_I_DP &dydx, const DP x,
@@ -40,8 +41,14 @@ void rkck(Vec_I_DP &y, Vec_I_DP &dydx, const DP x,
         yout[i]=y[i]+h*(c1*dydx[i]+c3*ak3[i]+c4*ak4[i]+c6*ak6[i]);
     for (i=0;i<n;i++)
         yerr[i]=h*(dc1*dydx[i]+dc3*ak3[i]+dc4*ak4[i]+dc5*ak5[i]+dc6*ak6[i]);
+    stats.rhs += 5;
 }
 
+// called after each accepted step of odeint with (x, y, hdid, hnext)
+// (0 if none)
+thread_local void (*step_hook)(const DP, Vec_I_DP &, const DP, const DP)(0);
+thread_local int step_order;// order of last step (set by rkqs, stifbs)
+
 void rkqs(Vec_IO_DP &y, Vec_IO_DP &dydx, DP &x, const DP htry,
           const DP eps, Vec_I_DP &yscal, DP &hdid, DP &hnext,
           void derivs(const DP, Vec_I_DP &, Vec_O_DP &))
@@ -59,21 +66,27 @@ void rkqs(Vec_IO_DP &y, Vec_IO_DP &dydx, DP &x, const DP htry,
         for (i=0;i<n;i++) errmax=MAX(errmax,fabs(yerr[i]/yscal[i]));
         errmax /= eps;
         if (errmax <= 1.0) break;
+        stats.rejected++;
         htemp=SAFETY*h*pow(errmax,PSHRNK);
         h=(h >= 0.0 ? MAX(htemp,0.1*h) : MIN(htemp,0.1*h));
         xnew=x+h;
-        if (xnew == x) nrerror("stepsize underflow in rkqs");
+        if (xnew == x) nrerror("stepsize underflow in rkqs",NR_STEP_TOO_SMALL);
     }
+    step_order=5;
     if (errmax > ERRCON) hnext=SAFETY*h*pow(errmax,PGROW);
     else hnext=5.0*h;
     x += (hdid=h);
     for (i=0;i<n;i++) y[i]=ytemp[i];
 }
 
-DP dxsav;
-int kmax,kount;
-Vec_DP *xp_p;
-Mat_DP *yp_p;
+thread_local DP dxsav;
+thread_local int kmax,kount;
+thread_local Vec_DP *xp_p;
+thread_local Mat_DP *yp_p;
+thread_local DP yabs=0.0;// if >0, yscal = |y| + yabs (absolute error control)
+thread_local DP h_resume=0.0;// if nonzero, first step of next odeint, which
+                             // continues from hnext of checkpoint
+thread_local DP h_last;// hnext at return of last odeint (see integrate_qss)
 
 void odeint(Vec_IO_DP &ystart, const DP x1, const DP x2, const DP eps,
             const DP h1, const DP hmin, int &nok, int &nbad,
@@ -92,14 +105,17 @@ void odeint(Vec_IO_DP &ystart, const DP x1, const DP x2, const DP eps,
     Vec_DP &xp=*xp_p;
     Mat_DP &yp=*yp_p;
     x=x1;
-    h=SIGN(h1,x2-x1);
+    h=SIGN(h_resume != 0.0 ? h_resume : h1,x2-x1);
+    hnext=(h_resume != 0.0 ? h : 0.0);// stifbs keeps kopt if h == hnext
+    h_resume=0.0;
     nok = nbad = kount = 0;
     for (i=0;i<nvar;i++) y[i]=ystart[i];
     if (kmax > 0) xsav=x-dxsav*2.0;
     for (nstp=0;nstp<MAXSTP;nstp++) {
         derivs(x,y,dydx);
+        stats.rhs++;
         for (i=0;i<nvar;i++)
-            yscal[i]=fabs(y[i])+fabs(dydx[i]*h)+TINY;
+            yscal[i]=fabs(y[i])+(yabs > 0.0 ? yabs : fabs(dydx[i]*h)+TINY);
         if (kmax > 0 && kount < kmax-1 && fabs(x-xsav) > fabs(dxsav)) {
             for (i=0;i<nvar;i++) yp[i][kount]=y[i];
             xp[kount++]=x;
@@ -108,18 +124,21 @@ void odeint(Vec_IO_DP &ystart, const DP x1, const DP x2, const DP eps,
         if ((x+h-x2)*(x+h-x1) > 0.0) h=x2-x;
         rkqs(y,dydx,x,h,eps,yscal,hdid,hnext,derivs);
         if (hdid == h) ++nok; else ++nbad;
+        stats.step(hdid);
+        if (step_hook) step_hook(x,y,hdid,hnext);
         if ((x-x2)*(x2-x1) >= 0.0) {
             for (i=0;i<nvar;i++) ystart[i]=y[i];
             if (kmax != 0) {
                 for (i=0;i<nvar;i++) yp[i][kount]=y[i];
                 xp[kount++]=x;
             }
+            h_last=hnext;
             return;
         }
-        if (fabs(hnext) <= hmin) nrerror("Step size too small in odeint");
+        if (fabs(hnext) <= hmin) nrerror("Step size too small in odeint",NR_STEP_TOO_SMALL);
         h=hnext;
     }
-    nrerror("Too many steps in routine odeint");
+    nrerror("Too many steps in routine odeint",NR_TOO_MANY_STEPS);
 }
 
 void odeint(Vec_DP& y, void f(double, const Vec_DP& y, Vec_DP& f),
@@ -133,7 +152,9 @@ void odeint(Vec_DP& y, void f(double, const Vec_DP& y, Vec_DP& f),
 // output:
 //   y = final value of dependent variables y at x=b
 {
-    int dum;
+    int nok,nbad;
     kmax = 0;
-    odeint(y,a,b, eps, (b-a)*eps, 0,dum,dum,f,rkqs);
+    odeint(y,a,b, eps, (b-a)*eps, 0,nok,nbad,f,rkqs);
+    stats.ok += nok;
+    stats.bad += nbad;
 }
\ No newline at end of file
@@ -0,0 +1,284 @@
+// Python extension module over the C++ engine
+// build: make pybbn (needs only CPython headers; numpy is used at run
+//   time if it can be imported)
+// usage in python:
+//   import pybbn
+//   pybbn.precision("standard")
+//   pybbn.init(6e-10, T_init=10, T_final=0.01, N_nu=3, tau=880)
+//   X = pybbn.integrate([1, 0.1, 0.01])
+//     # X[i,k] = mass fraction of pybbn.elements()[k] at T[i]
+//   X = pybbn.sweep([1e-10, 6e-10], T=[0.1, 0.01], precision="standard")
+//     # X[j,i,k] for eta[j] (other keywords as in init)
+//   r = pybbn.reaction_rates(0.1)
+//     # r[0] = forward, r[1] = backward rates of pybbn.reactions()
+// arrays are returned as numpy.ndarray (memoryview if numpy is not
+// available) that share memory of C++ vector without copy;
+// GIL is released while network is solved, so that python threads
+// run solvers in parallel; state of integration is separate for each
+// thread, i.e. init and integrate must be called in the same thread;
+// errors in numerical routines (nrerror) raise RuntimeError in init
+// and integrate (after retries by BBN::retry), and give rows of nan
+// for failed eta in sweep
+
+#include<Python.h>
+#include<cmath>
+#include<cstring>
+#include<vector>
+#include "job.h"
+#include "BBN.h"
+
+struct array_object {// owner of C++ buffer exported to python
+    PyObject_HEAD
+    std::vector<double> *v;
+    int ndim;
+    Py_ssize_t shape[3];
+    Py_ssize_t strides[3];
+};
+
+static PyTypeObject array_type = {
+    PyVarObject_HEAD_INIT(0, 0) "pybbn.array", sizeof(array_object)
+};
+static PyBufferProcs array_buffer;
+static PyObject *numpy(0);// numpy module (0 if not available)
+static thread_local bool initialized(false);// if init is called in thread
+
+static int array_getbuffer(PyObject *o, Py_buffer *b, int flags)
+{
+    array_object *a((array_object*)o);
+    b->buf = a->v->data();
+    b->obj = o;
+    Py_INCREF(o);
+    b->len = a->v->size()*sizeof(double);
+    b->readonly = 0;
+    b->itemsize = sizeof(double);
+    b->format = (char*)(flags & PyBUF_FORMAT ? "d" : 0);
+    b->ndim = a->ndim;
+    b->shape = (flags & PyBUF_ND) == PyBUF_ND ? a->shape : 0;
+    b->strides = (flags & PyBUF_STRIDES) == PyBUF_STRIDES ? a->strides : 0;
+    b->suboffsets = 0;
+    b->internal = 0;
+    return 0;
+}
+
+static void array_dealloc(PyObject *o)
+{
+    delete ((array_object*)o)->v;
+    Py_TYPE(o)->tp_free(o);
+}
+
+static PyObject *new_array(std::vector<double> *v, int ndim,
+                           Py_ssize_t n0, Py_ssize_t n1=0, Py_ssize_t n2=0)
+// return ndarray (or memoryview) of shape (n0,n1,n2)[:ndim] owning v
+{
+    array_object *a(PyObject_New(array_object, &array_type));
+    if(!a) { delete v; return 0; }
+    a->v = v;
+    a->ndim = ndim;
+    a->shape[0] = n0; a->shape[1] = n1; a->shape[2] = n2;
+    a->strides[ndim-1] = sizeof(double);
+    for(int i=ndim-1; i>0; i--) a->strides[i-1] = a->strides[i]*a->shape[i];
+    PyObject *r(numpy ? PyObject_CallMethod(numpy, "asarray", "O", a)
+                : PyMemoryView_FromObject((PyObject*)a));
+    Py_DECREF(a);
+    return r;
+}
+
+static bool to_vector(PyObject *o, std::vector<double>& v)
+// convert number or sequence of numbers to v
+{
+    v.clear();
+    if(PyNumber_Check(o) && !PySequence_Check(o)) {
+        v.push_back(PyFloat_AsDouble(o));
+        return !PyErr_Occurred();
+    }
+    PyObject *s(PySequence_Fast(o, "expected number or sequence"));
+    if(!s) return false;
+    for(Py_ssize_t i=0; i<PySequence_Fast_GET_SIZE(s); i++)
+        v.push_back(PyFloat_AsDouble(PySequence_Fast_GET_ITEM(s,i)));
+    Py_DECREF(s);
+    return !PyErr_Occurred();
+}
+
+static PyObject *precision(PyObject*, PyObject *args)
+{
+    const char *name;
+    if(!PyArg_ParseTuple(args, "s", &name)) return 0;
+    if(!BBN::precision(name)) {
+        PyErr_Format(PyExc_ValueError, "unknown precision %s", name);
+        return 0;
+    }
+    Py_RETURN_NONE;
+}
+
+static PyObject *init(PyObject*, PyObject *args, PyObject *kw)
+{
+    static const char *key[] = { "eta", "T_init", "T_final", "N_nu", "tau", 0 };
+    job j;
+    std::string err;
+    if(!PyArg_ParseTupleAndKeywords(args, kw, "d|dddd", (char**)key, &j.eta,
+                                    &j.T_init, &j.T_final, &j.N_nu, &j.tau))
+        return 0;
+    if(!j.check(err)) {
+        PyErr_SetString(PyExc_ValueError, err.c_str());
+        return 0;
+    }
+    Py_BEGIN_ALLOW_THREADS
+    try { BBN::init(j.eta, j.T_init, j.T_final, j.N_nu, j.tau); }
+    catch(const nr_error& e) { err = e.what(); }
+    Py_END_ALLOW_THREADS
+    if(err.size()) {
+        PyErr_SetString(PyExc_RuntimeError, err.c_str());
+        return 0;
+    }
+    initialized = true;
+    Py_RETURN_NONE;
+}
+
+static PyObject *integrate(PyObject*, PyObject *args)
+{
+    PyObject *o;
+    std::vector<double> T;
+    size_t i,k,n(BBN::N_element);
+    if(!PyArg_ParseTuple(args, "O", &o) || !to_vector(o, T)) return 0;
+    if(!initialized) {
+        PyErr_SetString(PyExc_RuntimeError, "init is not called in this thread");
+        return 0;
+    }
+    for(i=0; i<T.size(); i++)
+        if(T[i] <= 0 || (i && T[i] > T[i-1])) {
+            PyErr_SetString(PyExc_ValueError, "bad output temperatures");
+            return 0;
+        }
+    std::vector<double> *X(new std::vector<double>(T.size()*n));
+    int status(0);
+    Py_BEGIN_ALLOW_THREADS
+    for(i=0; i<T.size() && !status; i++) {
+        status = BBN::set_temperature(T[i]);
+        for(k=0; k<n; k++) (*X)[i*n + k] = BBN::mass_fraction(k);
+    }
+    Py_END_ALLOW_THREADS
+    if(status) {
+        delete X;
+        PyErr_SetString(PyExc_RuntimeError, BBN::error.c_str());
+        return 0;
+    }
+    return new_array(X, 2, T.size(), n);
+}
+
+static PyObject *sweep(PyObject*, PyObject *args, PyObject *kw)
+{
+    static const char *key[] = { "eta", "T", "T_init", "T_final", "N_nu",
+                                 "tau", "eps", "precision", 0 };
+    PyObject *o, *o_T(Py_None);
+    const char *name(BBN::prec.name);
+    std::vector<double> eta;
+    std::string err;
+    job j;
+    size_t i,k,m;
+    if(!PyArg_ParseTupleAndKeywords(args, kw, "O|Oddddds", (char**)key, &o,
+                                    &o_T, &j.T_init, &j.T_final, &j.N_nu,
+                                    &j.tau, &j.eps, &name)
+       || !to_vector(o, eta)
+       || (o_T != Py_None && !to_vector(o_T, j.T)))
+        return 0;
+    if(o_T == Py_None) j.T.push_back(j.T_final);
+    for(j.tier=0; BBN::tier[j.tier].name; j.tier++)
+        if(strcmp(BBN::tier[j.tier].name, name)==0) break;
+    if(!BBN::tier[j.tier].name) {
+        PyErr_Format(PyExc_ValueError, "unknown precision %s", name);
+        return 0;
+    }
+    for(i=0; i<eta.size(); i++) {
+        j.eta = eta[i];
+        if(j.check(err)) continue;
+        PyErr_SetString(PyExc_ValueError, err.c_str());
+        return 0;
+    }
+    m = j.T.size()*BBN::N_element;
+    std::vector<double> *X(new std::vector<double>(eta.size()*m));
+    BBN_precision p(BBN::prec);// run_job sets precision of job
+    Py_BEGIN_ALLOW_THREADS
+    job_result r;
+    for(i=0; i<eta.size(); i++) {
+        j.eta = eta[i];
+        run_job(j, r);
+        for(k=0; k<m; k++) (*X)[i*m + k] = (r.error.empty() ? r.X[k] : NAN);
+    }
+    Py_END_ALLOW_THREADS
+    BBN::prec = p;
+    initialized = true;// run_job calls init
+    return new_array(X, 3, eta.size(), j.T.size(), BBN::N_element);
+}
+
+static PyObject *reaction_rates(PyObject*, PyObject *args)
+{
+    double T;
+    int i,n(BBN::N_reaction);
+    if(!PyArg_ParseTuple(args, "d", &T)) return 0;
+    if(T <= 0) {
+        PyErr_SetString(PyExc_ValueError, "temperature must be positive");
+        return 0;
+    }
+    Vec_DP r1(n), r2(n);
+    BBN::reaction_init();
+    BBN::reaction_rate(r1, r2, T);
+    std::vector<double> *r(new std::vector<double>(2*n));
+    for(i=0; i<n; i++) { (*r)[i] = r1[i]; (*r)[n+i] = r2[i]; }
+    return new_array(r, 2, 2, n);
+}
+
+static PyObject *elements(PyObject*, PyObject*)
+{
+    PyObject *t(PyTuple_New(BBN::N_element));
+    for(int i=0; t && i<BBN::N_element; i++)
+        PyTuple_SET_ITEM(t, i, PyUnicode_FromString(BBN::element[i].name.c_str()));
+    return t;
+}
+
+static PyObject *reactions(PyObject*, PyObject*)
+{
+    PyObject *t(PyTuple_New(BBN::N_reaction));
+    for(int i=0; t && i<BBN::N_reaction; i++) {
+        const particle *p(BBN::reaction[i]);
+        std::string s(p[0].name + " + " + p[1].name + " -> "
+                      + p[2].name + " + " + p[3].name);
+        PyTuple_SET_ITEM(t, i, PyUnicode_FromString(s.c_str()));
+    }
+    return t;
+}
+
+static PyMethodDef methods[] = {
+    { "precision", precision, METH_VARARGS,
+      "precision(name): set accuracy tier (standard, reference)" },
+    { "init", (PyCFunction)(void(*)(void))init, METH_VARARGS | METH_KEYWORDS,
+      "init(eta, T_init=10, T_final=0.01, N_nu=3, tau=tau_n): "
+      "initialize network in calling thread" },
+    { "integrate", integrate, METH_VARARGS,
+      "integrate(T): mass fractions at decreasing temperatures T / MeV" },
+    { "sweep", (PyCFunction)(void(*)(void))sweep, METH_VARARGS | METH_KEYWORDS,
+      "sweep(eta, T=None, T_init=10, T_final=0.01, N_nu=3, tau=tau_n, "
+      "eps=0, precision=current): mass fractions for each eta" },
+    { "reaction_rates", reaction_rates, METH_VARARGS,
+      "reaction_rates(T): forward and backward rates at T / MeV" },
+    { "elements", elements, METH_NOARGS, "names of elements" },
+    { "reactions", reactions, METH_NOARGS, "names of reactions" },
+    { 0 }
+};
+
+static PyModuleDef module = {
+    PyModuleDef_HEAD_INIT, "pybbn",
+    "Big-Bang Nucleosynthesis (C++ engine)", -1, methods
+};
+
+PyMODINIT_FUNC PyInit_pybbn()
+{
+    array_buffer.bf_getbuffer = array_getbuffer;
+    array_type.tp_dealloc = array_dealloc;
+    array_type.tp_as_buffer = &array_buffer;
+    array_type.tp_flags = Py_TPFLAGS_DEFAULT;
+    array_type.tp_doc = "owner of C++ buffer";
+    if(PyType_Ready(&array_type) < 0) return 0;
+    numpy = PyImport_ImportModule("numpy");
+    if(!numpy) PyErr_Clear();
+    return PyModule_Create(&module);
+}
@@ -1,6 +1,7 @@
 // cubic spline interpolation
 // W. H. Press, et al, "Numerical Recipes" section 3.3
 
+#include<cmath>
 #include "nr.h"
 
 void spline(Vec_I_DP &x, Vec_I_DP &y, const DP yp1, const DP ypn,
@@ -49,7 +50,7 @@ void splint(Vec_I_DP &xa, Vec_I_DP &ya, Vec_I_DP &y2a, const DP x, DP &y)
         else klo=k;
     }
     h=xa[khi]-xa[klo];
-    if (h == 0.0) nrerror("Bad xa input to routine splint");
+    if (h == 0.0) nrerror("Bad xa input to routine splint",NR_BAD_INPUT);
     a=(xa[khi]-x)/h;
     b=(x-xa[klo])/h;
     y=a*ya[klo]+b*ya[khi]+((a*a*a-a)*y2a[klo]
@@ -61,4 +62,69 @@ double splint(Vec_I_DP &xa, Vec_I_DP &ya, Vec_I_DP &y2a, const DP x)
     double y;
     splint(xa, ya, y2a, x, y);
     return y;
-}
\ No newline at end of file
+}
+
+// monotone piecewise cubic Hermite interpolation
+// J. M. Hyman, SIAM J. Sci. Stat. Comput. 4 (1983) 645
+// derivatives are those of local parabola, limited so that
+// interpolant is monotone wherever data are monotone
+// (unlike harmonic mean of slopes as in pchip of MATLAB, accuracy
+//  is third order except near extrema, even for nonuniform grid)
+
+void pchip(Vec_I_DP &x, Vec_I_DP &y, Vec_O_DP &d)
+// input: x,y = data points (x in increasing order)
+// output: d = first derivatives at x
+{
+    int k;
+    DP h0,h1,s0,s1,m;
+
+    int n=d.size();
+    if (n == 2) {
+        d[0]=d[1]=(y[1]-y[0])/(x[1]-x[0]);
+        return;
+    }
+    for (k=1;k<n-1;k++) {
+        h0=x[k]-x[k-1];
+        h1=x[k+1]-x[k];
+        s0=(y[k]-y[k-1])/h0;
+        s1=(y[k+1]-y[k])/h1;
+        d[k]=(h1*s0+h0*s1)/(h0+h1);
+        m=3.0*MIN(fabs(s0),fabs(s1));
+        if (s0*s1 <= 0.0) d[k]=0.0;
+        else if (fabs(d[k]) > m) d[k]=SIGN(m,d[k]);
+    }
+    for (k=0;k<n;k+=n-1) {// one-sided three-point formula at ends
+        int j=(k ? -1 : 1);
+        h0=fabs(x[k+j]-x[k]);
+        h1=fabs(x[k+2*j]-x[k+j]);
+        s0=(y[k+j]-y[k])/(x[k+j]-x[k]);
+        s1=(y[k+2*j]-y[k+j])/(x[k+2*j]-x[k+j]);
+        d[k]=((2.0*h0+h1)*s0-h0*s1)/(h0+h1);
+        if (d[k]*s0 <= 0.0) d[k]=0.0;
+        else if (s0*s1 <= 0.0 && fabs(d[k]) > fabs(3.0*s0)) d[k]=3.0*s0;
+    }
+}
+
+double pchint(Vec_I_DP &xa, Vec_I_DP &ya, Vec_I_DP &da, const DP x)
+// input: xa,ya = data points
+//        da = output of pchip
+// return: interpolated value at x
+{
+    int k;
+    DP h,a,b;
+
+    int n=xa.size();
+    int klo=0;
+    int khi=n-1;
+    while (khi-klo > 1) {
+        k=(khi+klo) >> 1;
+        if (xa[k] > x) khi=k;
+        else klo=k;
+    }
+    h=xa[khi]-xa[klo];
+    if (h == 0.0) nrerror("Bad xa input to routine pchint",NR_BAD_INPUT);
+    a=(xa[khi]-x)/h;
+    b=(x-xa[klo])/h;
+    return a*a*((1.0+2.0*b)*ya[klo]+b*h*da[klo])
+        +b*b*((1.0+2.0*a)*ya[khi]-a*h*da[khi]);
+}
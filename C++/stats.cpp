@@ -0,0 +1,55 @@
+// statistics of ODE solvers
+
+#include<cmath>
+#include<chrono>
+#include "stats.h"
+
+thread_local solver_stats stats;
+
+solver_stats::solver_stats() : on(false) { reset(); }
+
+void solver_stats::reset()
+// clear counters (on is kept)
+{
+    ok = bad = rejected = rhs = jac = lu = mv = 0;
+    hmin = HUGE_VAL;
+    hmax = 0;
+    kopt.clear();
+    t_interp = t_network = 0;
+}
+
+void solver_stats::step(double h)
+// record accepted step size h
+{
+    h = fabs(h);
+    if(h < hmin) hmin = h;
+    if(h > hmax) hmax = h;
+}
+
+void solver_stats::print(std::ostream& o) const
+// print statistics in JSON format
+{
+    o << "{\"accepted\": " << ok+bad
+      << ", \"ok\": " << ok
+      << ", \"bad\": " << bad
+      << ", \"rejected\": " << rejected
+      << ", \"rhs\": " << rhs
+      << ", \"jac\": " << jac
+      << ", \"lu\": " << lu
+      << ", \"mv\": " << mv
+      << ", \"hmin\": " << (ok+bad ? hmin : 0)
+      << ", \"hmax\": " << hmax
+      << ", \"t_interp\": " << t_interp
+      << ", \"t_network\": " << t_network
+      << ", \"kopt\": [";
+    for(size_t i=0; i<kopt.size(); i++)
+        o << (i ? ", [" : "[") << kopt[i].first << ", " << kopt[i].second << ']';
+    o << "]}\n";
+}
+
+double solver_stats::clock()
+// wall clock / sec
+{
+    return std::chrono::duration<double>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
@@ -0,0 +1,32 @@
+// statistics of ODE solvers
+
+#ifndef __stats_h__
+#define __stats_h__
+
+#include<vector>
+#include<utility>
+#include<iostream>
+
+struct solver_stats {
+    bool on;// if true, record kopt history and wall time
+    long ok;// accepted steps with h==htry
+    long bad;// accepted steps with reduced h
+    long rejected;// rejected trial steps
+    long rhs;// evaluations of right hand side
+    long jac;// evaluations of jacobian
+    long lu;// LU decompositions
+    long mv;// products of jacobian and vector (KRYLOV_SOLVER)
+    double hmin, hmax;// min and max of accepted |h|
+    std::vector<std::pair<double,int> > kopt;// (x, kopt) after stifbs steps
+    double t_interp;// wall time of BBN::interp_init / sec
+    double t_network;// wall time of BBN::set_temperature / sec
+    solver_stats();
+    void reset();
+    void step(double h);
+    void print(std::ostream&) const;
+    static double clock();
+};
+
+extern thread_local solver_stats stats;// separate for each thread
+
+#endif // __stats_h__
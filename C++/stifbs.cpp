@@ -2,11 +2,69 @@
 // W. H. Press, et al, "Numerical Recipes" section 16.6
 
 #include <cmath>
-#include "nr.h"
+#include <vector>
+#include "stifbs.h"
+#include "stats.h"
+#include "trace.h"
 using namespace std;
 
 void ludcmp(Mat_DP &a, Vec_INT &indx, double &d);
 void lubksb(const Mat_DP &a, const Vec_INT &indx, Vec_DP &b);
+void elmhes(Mat_DP &a, Vec_INT &perm, Vec_DP &scale);
+void hesdcmp(const Mat_DP &h, const double s, Mat_DP &b, Vec_INT &piv);
+void hesbksb(const Mat_DP &h, const Vec_INT &perm, const Vec_DP &scale,
+             const Mat_DP &b, const Vec_INT &piv, Vec_DP &x);
+
+thread_local int linear_solver(LU_SOLVER);// solver of I - h*dfdy in simpr
+thread_local Mat_DP *hes_p;// dfdy reduced by elmhes (HESSENBERG_SOLVER)
+thread_local Vec_INT *perm_p;
+thread_local Vec_DP hes_scale;// balancing of dfdy (kept for next step)
+extern thread_local int step_order;// see odeint.cpp
+int gmres(void atimes(Vec_I_DP &, Vec_O_DP &), Vec_I_DP &pre, Vec_IO_DP &b,
+    const DP tol, const int m, const int maxit);
+
+// KRYLOV_SOLVER: I - h*dfdy is not formed, and (I - h*dfdy)x = b is
+// solved by GMRES with products dfdy*v given by jacvec_s at point of
+// jacobian (x_jac,*y_jac) and preconditioner I - h*diag(dfdy);
+// system is scaled by yscal of error control, so that residual is
+// small in every component, not only in large ones, and tolerance of
+// residual is KRY_TOL times eps of the step (error of solution in
+// scaled norm is then far below error allowed by extrapolation)
+static thread_local void (*jacvec_s)(double, const Vec_DP&, const Vec_DP&, Vec_DP&);
+static thread_local bool krylov;// if KRYLOV_SOLVER is used in this step
+static thread_local DP x_jac,h_kry,eps_kry;
+const DP KRY_TOL=1.0e-3;
+static thread_local const Vec_DP *y_jac,*s_jac;// y and yscal of step
+static thread_local Vec_DP diag_jac;// diagonal of dfdy
+
+static void kry_atimes(Vec_I_DP &v, Vec_O_DP &w)
+// w = S^{-1} (I - h*dfdy) S v, where S = diag(yscal)
+{
+    int i,n=v.size();
+    const Vec_DP &s=*s_jac;
+    Vec_DP u(n);
+    for (i=0;i<n;i++) u[i]=s[i]*v[i];
+    jacvec_s(x_jac,*y_jac,u,w);
+    stats.mv++;
+    for (i=0;i<n;i++) w[i]=v[i]-h_kry*w[i]/s[i];
+}
+
+static inline void solve(const Mat_DP &a, const Vec_INT &indx, Vec_DP &b)
+{
+    if (krylov) {
+        int i,n=b.size();
+        const Vec_DP &s=*s_jac;
+        Vec_DP pre(n);
+        for (i=0;i<n;i++) {
+            pre[i]=1.0-h_kry*diag_jac[i];
+            b[i] /= s[i];
+        }
+        gmres(kry_atimes,pre,b,KRY_TOL*eps_kry,MIN(n,30),100*n+100);
+        for (i=0;i<n;i++) b[i] *= s[i];
+    }
+    else if (linear_solver == HESSENBERG_SOLVER) hesbksb(*hes_p,*perm_p,hes_scale,a,indx,b);
+    else lubksb(a,indx,b);
+}
 
 void simpr(Vec_I_DP &y, Vec_I_DP &dydx, Vec_I_DP &dfdx, Mat_I_DP &dfdy,
     const DP xs, const DP htot, const int nstep, Vec_O_DP &yout,
@@ -16,18 +74,29 @@ void simpr(Vec_I_DP &y, Vec_I_DP &dydx, Vec_I_DP &dfdx, Mat_I_DP &dfdy,
     DP d,h,x;
 
     int n=y.size();
-    Mat_DP a(n,n);
-    Vec_INT indx(n);
+    Mat_DP a;
+    Vec_INT indx;
     Vec_DP del(n),ytemp(n);
     h=htot/nstep;
-    for (i=0;i<n;i++) {
-        for (j=0;j<n;j++) a[i][j] = -h*dfdy[i][j];
-        ++a[i][i];
+    if (krylov) h_kry=h;
+    else {
+        a=Mat_DP(n,n);
+        indx=Vec_INT(n);
+        if (linear_solver == HESSENBERG_SOLVER)
+            hesdcmp(*hes_p,h,a,indx);
+        else {
+            for (i=0;i<n;i++) {
+                for (j=0;j<n;j++) a[i][j] = -h*dfdy[i][j];
+                ++a[i][i];
+            }
+            ludcmp(a,indx,d);
+        }
+        stats.lu++;
     }
-    ludcmp(a,indx,d);
+    stats.rhs += nstep;
     for (i=0;i<n;i++)
         yout[i]=h*(dydx[i]+h*dfdx[i]);
-    lubksb(a,indx,yout);
+    solve(a,indx,yout);
     for (i=0;i<n;i++)
         ytemp[i]=y[i]+(del[i]=yout[i]);
     x=xs+h;
@@ -35,20 +104,20 @@ void simpr(Vec_I_DP &y, Vec_I_DP &dydx, Vec_I_DP &dfdx, Mat_I_DP &dfdy,
     for (nn=2;nn<=nstep;nn++) {
         for (i=0;i<n;i++)
             yout[i]=h*yout[i]-del[i];
-        lubksb(a,indx,yout);
+        solve(a,indx,yout);
         for (i=0;i<n;i++) ytemp[i] += (del[i] += 2.0*yout[i]);
         x += h;
         derivs(x,ytemp,yout);
     }
     for (i=0;i<n;i++)
         yout[i]=h*yout[i]-del[i];
-    lubksb(a,indx,yout);
+    solve(a,indx,yout);
     for (i=0;i<n;i++)
         yout[i] += ytemp[i];
 }
 
-Vec_DP *x_p;
-Mat_DP *d_p;
+thread_local Vec_DP *x_p;
+thread_local Mat_DP *d_p;
 
 void pzextr(const int iest, const DP xest, Vec_I_DP &yest, Vec_O_DP &yz,
     Vec_O_DP &dy)
@@ -83,30 +152,40 @@ void pzextr(const int iest, const DP xest, Vec_I_DP &yest, Vec_O_DP &yz,
     }
 }
 
-void (*jacobn_s)(double, const Vec_DP&, Vec_DP&, Mat_DP&);
+thread_local void (*jacobn_s)(double, const Vec_DP&, Vec_DP&, Mat_DP&);
+
+const int KMAXX=7,IMAXX=KMAXX+1;
+static thread_local struct {// state of stifbs kept between steps
+    int first=1,kmax,kopt,nvold = -1;
+    DP epsold = -1.0,xnew;
+    Vec_DP a{IMAXX};
+    Mat_DP alf{KMAXX,KMAXX};
+} bs;
 
 void stifbs(Vec_IO_DP &y, Vec_IO_DP &dydx, DP &xx, const DP htry,
     const DP eps, Vec_I_DP &yscal, DP &hdid, DP &hnext,
     void derivs(const DP, Vec_I_DP &, Vec_O_DP &))
 {
-    const int KMAXX=7,IMAXX=KMAXX+1;
     const DP SAFE1=0.25,SAFE2=0.7,REDMAX=1.0e-5,REDMIN=0.7;
     const DP TINY=1.0e-30,SCALMX=0.1;
     bool exitflag=false;
     int i,iq,k,kk,km,reduct;
-    static int first=1,kmax,kopt,nvold = -1;
+    int &first=bs.first,&kmax=bs.kmax,&kopt=bs.kopt,&nvold=bs.nvold;
     DP eps1,errmax,fact,h,red,scale,work,wrkmin,xest;
-    static DP epsold = -1.0,xnew;
-    static Vec_DP a(IMAXX);
-    static Mat_DP alf(KMAXX,KMAXX);
+    DP &epsold=bs.epsold,&xnew=bs.xnew;
+    Vec_DP &a=bs.a;
+    Mat_DP &alf=bs.alf;
     static int nseq_d[IMAXX]={2,6,10,14,22,34,50,70};
     Vec_INT nseq(nseq_d,IMAXX);
 
+    TRACE_ARG("stifbs", "columns", 0);
     int nv=y.size();
-    d_p=new Mat_DP(nv,KMAXX);
-    x_p=new Vec_DP(KMAXX);
-    Vec_DP dfdx(nv),err(KMAXX),yerr(nv),ysav(nv),yseq(nv);
-    Mat_DP dfdy(nv,nv);
+    krylov=(linear_solver == KRYLOV_SOLVER && jacvec_s);
+    Mat_DP d_tab(nv,KMAXX),dfdy,hes;// (freed if nrerror throws)
+    Vec_DP x_tab(KMAXX),dfdx(nv),err(KMAXX),yerr(nv),ysav(nv),yseq(nv);
+    Vec_INT perm;
+    d_p=&d_tab;
+    x_p=&x_tab;
     if (eps != epsold || nv != nvold) {
         hnext = xnew = -1.0e29;
         eps1=SAFE1*eps;
@@ -127,7 +206,27 @@ void stifbs(Vec_IO_DP &y, Vec_IO_DP &dydx, DP &xx, const DP htry,
     }
     h=htry;
     for (i=0;i<nv;i++) ysav[i]=y[i];
-    jacobn_s(xx,y,dfdx,dfdy);
+    if (!krylov) dfdy=Mat_DP(nv,nv);
+    {
+        TRACE("jacobn");
+        jacobn_s(xx,y,dfdx,dfdy);
+    }
+    stats.jac++;
+    if (krylov) {// dfdy is given by products at (xx,ysav)
+        x_jac=xx;
+        eps_kry=eps;
+        y_jac=&ysav;
+        s_jac=&yscal;
+        diag_jac=Vec_DP(nv);
+        jacvec_s(xx,ysav,Vec_DP(),diag_jac);
+    }
+    else if (linear_solver == HESSENBERG_SOLVER) {// reduce once per step
+        hes=dfdy;
+        perm=Vec_INT(nv);
+        hes_p=&hes;
+        perm_p=&perm;
+        elmhes(hes,perm,hes_scale);
+    }
     if (xx != xnew || h != hnext) {
         first=1;
         kopt=kmax;
@@ -137,7 +236,10 @@ void stifbs(Vec_IO_DP &y, Vec_IO_DP &dydx, DP &xx, const DP htry,
         for (k=0;k<=kmax;k++) {
             xnew=xx+h;
 //            if (xnew == xx) nrerror("step size underflow in stifbs");
-            simpr(ysav,dydx,dfdx,dfdy,xx,h,nseq[k],yseq,derivs);
+            {
+                TRACE_ARG("simpr", "nstep", nseq[k]);
+                simpr(ysav,dydx,dfdx,dfdy,xx,h,nseq[k],yseq,derivs);
+            }
             xest=SQR(h/nseq[k]);
             pzextr(k,xest,yseq,y,yerr);
             if (k != 0) {
@@ -175,7 +277,10 @@ void stifbs(Vec_IO_DP &y, Vec_IO_DP &dydx, DP &xx, const DP htry,
         red=MAX(red,REDMAX);
         h *= red;
         reduct=1;
+        stats.rejected++;
     }
+    TRACE_SET(k+1);
+    step_order=k+1;// number of columns of extrapolation
     xx=xnew;
     hdid=h;
     first=0;
@@ -197,8 +302,7 @@ void stifbs(Vec_IO_DP &y, Vec_IO_DP &dydx, DP &xx, const DP htry,
             kopt++;
         }
     }
-    delete d_p;
-    delete x_p;
+    if (stats.on) stats.kopt.push_back(make_pair(xx,kopt));
 }
 
 void odeint(Vec_IO_DP &ystart, const DP x1, const DP x2, const DP eps,
@@ -208,23 +312,80 @@ void odeint(Vec_IO_DP &ystart, const DP x1, const DP x2, const DP eps,
                       Vec_I_DP &, DP &, DP &,
                       void (*)(const DP, Vec_I_DP &, Vec_O_DP &)));
 
+void stifbs_save(vector<DP> &s)
+// append state of stifbs kept between steps to s
+{
+    int i,j;
+    s.push_back(bs.first);
+    s.push_back(bs.kmax);
+    s.push_back(bs.kopt);
+    s.push_back(bs.nvold);
+    s.push_back(bs.epsold);
+    s.push_back(bs.xnew);
+    for (i=0;i<IMAXX;i++) s.push_back(bs.a[i]);
+    for (i=0;i<KMAXX;i++)
+        for (j=0;j<KMAXX;j++) s.push_back(bs.alf[i][j]);
+    s.push_back(hes_scale.size());
+    for (i=0;i<hes_scale.size();i++) s.push_back(hes_scale[i]);
+}
+
+bool stifbs_load(const DP *&p, const DP *end)
+// restore state saved by stifbs_save from p (advanced past it)
+// return false if [p,end) is too short
+{
+    int i,j,n;
+    if (end-p < 7+IMAXX+KMAXX*KMAXX) return false;
+    bs.first=int(*p++);
+    bs.kmax=int(*p++);
+    bs.kopt=int(*p++);
+    bs.nvold=int(*p++);
+    bs.epsold=*p++;
+    bs.xnew=*p++;
+    for (i=0;i<IMAXX;i++) bs.a[i]=*p++;
+    for (i=0;i<KMAXX;i++)
+        for (j=0;j<KMAXX;j++) bs.alf[i][j]=*p++;
+    n=int(*p++);
+    if (end-p < n) return false;
+    hes_scale=Vec_DP(p,n);
+    p+=n;
+    return true;
+}
+
 void odeint(Vec_DP& y, void f(double, const Vec_DP& y, Vec_DP& f),
                  void jac(double, const Vec_DP& fx, Vec_DP&, Mat_DP& fy),
+                 void jacvec(double, const Vec_DP&, const Vec_DP&, Vec_DP&),
                  double a, double b, double eps)
 // solve initial value problem for stiff differential equation
 // input:
 //   y = initial value of dependent variables y at x=a
 //   f = right hand side of differential equaiton dy/dx = f(x,y)
 //   jac = jacobian dfdx and dfdy (used in stiff solver)
+//   jacvec(x,y,v,w) computes w = dfdy*v, or diagonal of dfdy if v is
+//     empty, in O(n) memory (used if linear_solver is KRYLOV_SOLVER,
+//     in which case jac is called with empty dfdy and computes only
+//     dfdx; if jacvec is 0, LU_SOLVER is used instead)
 //   a,b = span of independent variable x for integration
 //   eps = error tolerance (Numerical Recipes, section 16.2)
 // output:
 //   y = final value of dependent variables y at x=b
 {
     if(a==b) return;
-    int dum;
-    extern int kmax;
+    TRACE("odeint");
+    int nok,nbad;
+    extern thread_local int kmax;
     kmax = 0;
     jacobn_s = jac;
-    odeint(y,a,b, eps, (b-a)*eps, 0,dum,dum,f,stifbs);
-}
\ No newline at end of file
+    jacvec_s = jacvec;
+    extern thread_local DP h_resume;
+    if(h_resume == 0) hes_scale = Vec_DP(1.0, y.size());// for reproducibility
+    odeint(y,a,b, eps, (b-a)*eps, 0,nok,nbad,f,stifbs);
+    stats.ok += nok;
+    stats.bad += nbad;
+}
+
+void odeint(Vec_DP& y, void f(double, const Vec_DP& y, Vec_DP& f),
+                 void jac(double, const Vec_DP& fx, Vec_DP&, Mat_DP& fy),
+                 double a, double b, double eps)
+// same as above without jacvec
+{ odeint(y,f,jac,0,a,b,eps); }
+
@@ -0,0 +1,18 @@
+// stiff integrator by semi-implicit extrapolation (see stifbs.cpp)
+
+#ifndef __stifbs_h__
+#define __stifbs_h__
+
+#include "nr.h"
+
+// linear solver in stiff integrator
+enum { LU_SOLVER,// LU decomposition of I - h*dfdy for each h
+       HESSENBERG_SOLVER,// Hessenberg reduction of dfdy once per step
+       KRYLOV_SOLVER };// GMRES by products dfdy*v (LU if not given)
+extern thread_local int linear_solver;
+
+void stifbs(Vec_IO_DP &y, Vec_IO_DP &dydx, DP &xx, const DP htry,
+    const DP eps, Vec_I_DP &yscal, DP &hdid, DP &hnext,
+    void derivs(const DP, Vec_I_DP &, Vec_O_DP &));
+
+#endif // __stifbs_h__
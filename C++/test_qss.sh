@@ -0,0 +1,26 @@
+#!/bin/sh
+# trajectory test of QSS: mass fractions of fig5-6 -q ratio (QSS) must
+# agree with those of stiff solution (fig5-6) within tolerance at all
+# temperatures (mass fraction below 1e-25 is not compared)
+# usage: sh test_qss.sh [ratio [tolerance]]  (default 1e4 1e-3)
+#   (builds a.out by make fig5-6)
+
+set -e
+q=${1:-1e4}
+tol=${2:-1e-3}
+make -s fig5-6
+d=$(mktemp -d)
+trap 'rm -rf "$d"' EXIT
+cp a.out "$d/fig5-6"
+cd "$d"
+./fig5-6 > /dev/null
+mv fig5-6.txt ref.txt
+./fig5-6 -q $q > /dev/null
+if awk -v tol=$tol 'NR==FNR { for(j=2;j<=NF;j++) x[FNR,j]=$j; next }
+    { for(j=2;j<=NF;j++) if(x[FNR,j] > 1e-25) {
+        e = ($j - x[FNR,j])/x[FNR,j]; if(e < 0) e = -e;
+        if(e > m) { m = e; T = $1; k = j } } }
+    END { printf("max error %.3g at T=%g (column %d)\n", m, T, k); exit !(m < tol) }' \
+    ref.txt fig5-6.txt
+then echo "ok: fig5-6 -q $q agrees with stiff solution"
+else echo "FAIL: fig5-6 -q $q differs from stiff solution"; exit 1; fi
@@ -0,0 +1,27 @@
+#!/bin/sh
+# kill/resume test of checkpoint: fig7 writing checkpoints is killed
+# halfway, resumed from the checkpoint without options (they are
+# restored from it), and fig7.txt must equal that of uninterrupted run
+# usage: sh test_resume.sh [options of fig7]  (default -T)
+#   (builds a.out by make fig7)
+
+set -e
+opt=${*:--T}
+make -s fig7
+d=$(mktemp -d)
+trap 'rm -rf "$d"' EXIT
+cp a.out "$d/fig7"
+cd "$d"
+t0=$(date +%s.%N)
+./fig7 $opt > /dev/null
+t1=$(date +%s.%N)
+mv fig7.txt ref.txt
+./fig7 $opt -c ck -i 0 > /dev/null &
+p=$!
+sleep $(awk "BEGIN { print ($t1 - $t0)/2 }")
+kill -9 $p
+{ wait $p; } 2>/dev/null || true
+if [ ! -f ck ]; then echo "fig7 $opt finished before it was killed"; exit 1; fi
+./fig7 -c ck > /dev/null
+if cmp -s fig7.txt ref.txt; then echo "ok: fig7 $opt resumed"
+else echo "FAIL: resumed fig7 $opt differs"; exit 1; fi
@@ -0,0 +1,61 @@
+// validation of precision tiers (see BBN::precision):
+// solve network for several eta with each tier and compare
+// mass fractions at T=0.01MeV with those of reference tier
+// usage: tiers [-n points]
+// output: max relative error for each element, wall time and
+//   speedup relative to reference for each tier;
+//   exit status is 1 if error exceeds budget of some tier, or if
+//   solver fails (retries are disabled, so that each tier is measured
+//   with its own settings)
+
+#include<cmath>
+#include<cstdlib>
+#include<cstring>
+#include<vector>
+#include "stats.h"
+#include "BBN.h"
+
+int main(int argc, char **argv) try {
+    int i,j,k,n(7),r,fail(0);
+    double eta0(1e-11), eta1(1e-8), T0(10), T1(0.01);
+    double eta, t, e, t_ref(0);
+    for(i=1; i<argc; i++)
+        if(strcmp(argv[i],"-n")==0 && i+1<argc) n = atoi(argv[++i]);
+    if(n<2) n = 2;
+    BBN::retry.n = 0;
+    for(r=0; BBN::tier[r+1].name; r++);// reference is last tier
+    std::vector<std::vector<double> > X(n), X_ref(n);
+    for(k=r; k>=0; k--) {
+        BBN::precision(BBN::tier[k].name);
+        t = solver_stats::clock();
+        for(i=0; i<n; i++) {
+            eta = eta0*pow(eta1/eta0, double(i)/(n-1));
+            BBN::init(eta, T0, T1);
+            if(BBN::set_temperature(T1)) nrerror(BBN::error.c_str());
+            X[i].resize(BBN::N_element);
+            for(j=0; j<BBN::N_element; j++) X[i][j] = BBN::mass_fraction(j);
+        }
+        t = solver_stats::clock() - t;
+        if(k==r) { X_ref = X; t_ref = t; }
+        std::cout << BBN::tier[k].name;
+        for(j=0, e=0; j<BBN::N_element; j++) {
+            double e_j(0);// max relative error of element j
+            for(i=0; i<n; i++)
+                e_j = MAX(e_j, fabs(X[i][j]/X_ref[i][j] - 1));
+            std::cout << ' ' << BBN::element[j].name << '=' << e_j;
+            // free neutrons are negligible at T1
+            if(j != BBN::n_index) e = MAX(e, e_j);
+        }
+        std::cout << " time=" << t << " speedup=" << t_ref/t;
+        if(e > BBN::tier[k].budget && k<r) {
+            std::cout << " exceeds budget " << BBN::tier[k].budget;
+            fail = 1;
+        }
+        std::cout << std::endl;
+    }
+    return fail;
+}
+catch(const nr_error& e) {
+    std::cerr << "tiers: " << e.what() << '\n';
+    return 1;
+}
@@ -0,0 +1,85 @@
+// timeline tracing of solver phases (see trace.h)
+
+#ifdef BBN_TRACE
+
+#include<chrono>
+#include<fstream>
+#include<iomanip>
+#include<mutex>
+#include<vector>
+#include "trace.h"
+
+struct trace_buffer {// ring buffer of one thread
+    int tid;
+    unsigned long n;// number of events recorded so far
+    trace_event e[trace_capacity];
+};
+
+static std::mutex lock;// for buffers
+static std::vector<trace_buffer*> buffers;// never freed, so that
+                                          // events survive threads
+static const std::chrono::steady_clock::time_point epoch(
+    std::chrono::steady_clock::now());
+
+static double now()
+// time since start of program / usec
+{
+    return std::chrono::duration<double, std::micro>(
+        std::chrono::steady_clock::now() - epoch).count();
+}
+
+static trace_buffer *buffer()
+// ring buffer of calling thread
+{
+    static thread_local trace_buffer *b(0);
+    if(b) return b;
+    b = new trace_buffer;
+    b->n = 0;
+    std::lock_guard<std::mutex> l(lock);
+    b->tid = buffers.size() + 1;
+    buffers.push_back(b);
+    return b;
+}
+
+trace_scope::trace_scope(const char *name, const char *key, double value)
+{
+    e.name = name;
+    e.key = key;
+    e.value = value;
+    e.t0 = now();
+}
+
+trace_scope::~trace_scope()
+{
+    trace_buffer *b(buffer());
+    e.t1 = now();
+    b->e[b->n++ % trace_capacity] = e;
+}
+
+void trace_dump(const char *file)
+// write events of all threads to file in Chrome trace format
+// (should be called when traced threads are idle)
+{
+    std::ofstream f(file);
+    std::lock_guard<std::mutex> l(lock);
+    const char *sep("");
+    f << "{\"traceEvents\": [";
+    for(size_t i=0; i<buffers.size(); i++) {
+        trace_buffer *b(buffers[i]);
+        unsigned long k(b->n > trace_capacity ? b->n - trace_capacity : 0);
+        for(; k < b->n; k++) {
+            const trace_event& e(b->e[k % trace_capacity]);
+            f << sep << "\n{\"name\": \"" << e.name
+              << "\", \"ph\": \"X\", \"pid\": 1, \"tid\": " << b->tid
+              << std::fixed << std::setprecision(3)
+              << ", \"ts\": " << e.t0 << ", \"dur\": " << e.t1 - e.t0
+              << std::defaultfloat << std::setprecision(6);
+            if(e.key) f << ", \"args\": {\"" << e.key << "\": " << e.value << '}';
+            f << '}';
+            sep = ",";
+        }
+    }
+    f << "\n]}\n";
+}
+
+#endif // BBN_TRACE
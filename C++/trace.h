@@ -0,0 +1,50 @@
+// timeline tracing of solver phases
+//
+// TRACE("name") records wall time of enclosing scope as one event;
+// TRACE_ARG("name", "key", value) attaches one number to the event,
+// which may be updated before end of scope by TRACE_SET(value).
+// events are kept in ring buffer of each thread (latest trace_capacity
+// events) and written by trace_dump(file) in Chrome trace format
+// (load in chrome://tracing or https://ui.perfetto.dev).
+// all of them are compiled out unless BBN_TRACE is defined, e.g.
+//   make clean; make CXXFLAGS=-DBBN_TRACE fig5-6
+
+#ifndef __trace_h__
+#define __trace_h__
+
+#ifdef BBN_TRACE
+
+const int trace_capacity(1<<16);// events per thread
+
+struct trace_event {
+    const char *name;
+    const char *key;// name of argument (0 if none)
+    double value;// argument
+    double t0, t1;// start and end / usec
+};
+
+struct trace_scope {
+    trace_event e;
+    trace_scope(const char *name, const char *key=0, double value=0);
+    ~trace_scope();
+};
+
+void trace_dump(const char *file);
+
+#define TRACE_CAT(a,b) a##b
+#define TRACE_VAR(l) TRACE_CAT(trace_scope_, l)
+#define TRACE(name) trace_scope TRACE_VAR(__LINE__)(name)
+#define TRACE_ARG(name, key, value) trace_scope trace_scope_arg_(name, key, value)
+#define TRACE_SET(v) (trace_scope_arg_.e.value = (v))
+#define TRACE_DUMP(file) trace_dump(file)
+
+#else
+
+#define TRACE(name)
+#define TRACE_ARG(name, key, value)
+#define TRACE_SET(v)
+#define TRACE_DUMP(file)
+
+#endif // BBN_TRACE
+
+#endif // __trace_h__
@@ -0,0 +1,179 @@
+// work-precision harness: solve scenarios of fig5-6, fig7 and fig8
+// with several methods and error tolerances, and compare final mass
+// fractions with those of reference tier (see BBN::precision)
+// usage: workprec [-w] [-p file]
+//   -w: write results to workprec.ref as baseline of regression test
+//   -p file: compare reference with python implementation
+//            (output of ../workprec.py)
+// output: workprec.txt (plotted by workprec.plt) with lines of
+//   scenario method eps time rhs error
+// where time = wall time / sec, rhs = evaluations of right hand side,
+// error = max relative error of mass fractions (except free neutrons);
+// exit status is 1 if rhs, time or error regresses from workprec.ref
+// beyond threshold (rhs_ratio, time_ratio, error_ratio below;
+// time_slack / sec is allowed in addition for noise of timer), if run
+// is missing from workprec.ref (rewrite it by -w when method is added),
+// or if solver fails in some run: retries of set_temperature are disabled
+// (BBN::retry.n=0), so that every run is of the method as labeled
+
+#include<cmath>
+#include<cstring>
+#include<fstream>
+#include<sstream>
+#include<string>
+#include<vector>
+#include<map>
+#include "stats.h"
+#include "BBN.h"
+
+const double rhs_ratio(1.1), time_ratio(2), time_slack(0.05), error_ratio(2);
+
+struct scenario {
+    const char *name;
+    double N_nu;// number of neutrino generation
+    int n_eta;// number of eta in [1e-11, 1e-8] (1 if eta=5e-10)
+    int n_T;// number of output temperatures in [T_final, T_init]
+};
+
+static const scenario S[] = {
+    { "fig5-6", 3, 1, 256 },
+    { "fig7",   3, 7, 1 },
+    { "fig8_n2", 2, 7, 1 },
+    { "fig8_n4", 4, 7, 1 }
+};
+static const char *method[] = { "stiff", "log", "nse", "hessenberg", "lnT",
+                                 "krylov" };
+static const double tolerance[] = { 1e-5, 3e-6, 1e-6, 3e-7, 1e-7, 1e-8 };
+static const double T0(10), T1(0.01);
+
+static double eta_(const scenario& s, int i)
+{
+    return s.n_eta==1 ? 5e-10 : 1e-11*pow(1e3, double(i)/(s.n_eta-1));
+}
+
+static void solve(std::vector<double>& X, double eta, double N_nu, int n_T)
+// append final mass fractions (except free neutrons) to X
+// after n_T outputs at logarithmic interval of temperature
+{
+    int i;
+    BBN::init(eta, T0, T1, N_nu);
+    for(i=1; i<=n_T; i++)
+        if(BBN::set_temperature(T0*pow(T1/T0, double(i)/n_T))) nrerror(BBN::error.c_str());
+    for(i=0; i<BBN::N_element; i++)
+        if(i != BBN::n_index) X.push_back(BBN::mass_fraction(i));
+}
+
+static double error(const std::vector<double>& X, const std::vector<double>& X0)
+// max relative error of X from X0
+{
+    double e(0);
+    for(size_t i=0; i<X.size(); i++) e = MAX(e, fabs(X[i]/X0[i] - 1));
+    return e;
+}
+
+static void python(const char *file)
+// compare python results (lines of N_nu eta X...) with reference
+{
+    std::ifstream f(file);
+    std::string line;
+    double N_nu, eta, x, e(0);
+    int n(0);
+    if(!f) { std::cerr << "cannot read " << file << '\n'; return; }
+    BBN::precision("reference");
+    while(std::getline(f, line)) {
+        std::istringstream s(line);
+        std::vector<double> X, X0;
+        if(!(s >> N_nu >> eta)) continue;
+        for(int i=0; s >> x; i++) if(i != BBN::n_index) X.push_back(x);
+        solve(X0, eta, N_nu, 1);
+        if(X.size() != X0.size()) { std::cerr << "bad line: " << line << '\n'; continue; }
+        e = MAX(e, error(X, X0));
+        n++;
+    }
+    std::cout << "python vs reference: max relative error " << e
+              << " (" << n << " points)\n";
+}
+
+int main(int argc, char **argv) try {
+    int i,j,k,l,n(sizeof(S)/sizeof(S[0])),fail(0);
+    int n_method(sizeof(method)/sizeof(method[0]));
+    int n_tol(sizeof(tolerance)/sizeof(tolerance[0]));
+    bool write(false);
+    const char *py(0);
+    double t,e;
+    long rhs;
+    std::ofstream f("workprec.txt");
+    std::ostringstream out;
+    std::map<std::string, std::vector<double> > ref;// baseline
+    for(i=1; i<argc; i++) {
+        if(strcmp(argv[i],"-w")==0) write = true;
+        else if(strcmp(argv[i],"-p")==0 && i+1<argc) py = argv[++i];
+    }
+    BBN::retry.n = 0;
+    if(!write) {
+        std::ifstream r("workprec.ref");
+        std::string key,m,tol;
+        double a[3];
+        while(r >> key >> m >> tol >> a[0] >> a[1] >> a[2])
+            ref[key + ' ' + m + ' ' + tol].assign(a, a+3);
+    }
+    for(i=0; i<n; i++) {
+        std::vector<double> X0, X;
+        BBN::precision("reference");
+        BBN::log_abundance = BBN::nse_start = BBN::log_temperature = false;
+        linear_solver = LU_SOLVER;
+        for(k=0; k<S[i].n_eta; k++)
+            solve(X0, eta_(S[i], k), S[i].N_nu, S[i].n_T);
+        for(j=0; j<n_method; j++) {
+            for(l=0; l<n_tol; l++) {
+                BBN::precision("standard");
+                BBN::interp_init(T0, T1, S[i].N_nu);// exclude from time
+                BBN::log_abundance = (j==1);
+                BBN::nse_start = (j==2);
+                BBN::log_temperature = (j==4);
+                linear_solver = (j==3 ? HESSENBERG_SOLVER :
+                                 j==5 ? KRYLOV_SOLVER : LU_SOLVER);
+                BBN::eps = tolerance[l];
+                X.clear();
+                stats.reset();
+                std::ostringstream key;
+                key << S[i].name << ' ' << method[j] << ' ' << tolerance[l];
+                t = solver_stats::clock();
+                try {
+                    for(k=0; k<S[i].n_eta; k++)
+                        solve(X, eta_(S[i], k), S[i].N_nu, S[i].n_T);
+                }
+                catch(const nr_error& x) {
+                    std::cout << key.str() << " FAILED: " << x.what() << std::endl;
+                    fail = 1;
+                    continue;
+                }
+                t = solver_stats::clock() - t;
+                rhs = stats.rhs;
+                e = error(X, X0);
+                out << key.str() << ' ' << t << ' ' << rhs << ' ' << e << '\n';
+                std::cout << key.str() << " time=" << t << " rhs=" << rhs
+                          << " error=" << e;
+                if(ref.count(key.str())) {
+                    const std::vector<double>& a(ref[key.str()]);
+                    if(rhs > a[1]*rhs_ratio) { std::cout << " RHS REGRESSED"; fail = 1; }
+                    if(t > a[0]*time_ratio + time_slack) { std::cout << " TIME REGRESSED"; fail = 1; }
+                    if(e > a[2]*error_ratio) { std::cout << " ERROR REGRESSED"; fail = 1; }
+                }
+                else if(!write) { std::cout << " NO BASELINE"; fail = 1; }
+                std::cout << std::endl;
+            }
+            out << "\n\n";// separate data block for gnuplot
+        }
+    }
+    BBN::log_abundance = BBN::nse_start = BBN::log_temperature = false;
+    linear_solver = LU_SOLVER;
+    if(py) python(py);
+    f << out.str();
+    if(write) std::ofstream("workprec.ref") << out.str();
+    return fail;
+}
+catch(const nr_error& e) {
+    std::cerr << "workprec: " << e.what() << '\n';
+    return 1;
+}
@@ -0,0 +1,16 @@
+reset
+#set terminal aqua
+set terminal postscript eps enhanced 24
+set output "workprec.eps"
+set logscale xy
+set xlabel "evaluations of right hand side"
+set ylabel "max relative error"
+set format xy "10^{%T}"
+set key top right
+set label "fig7 scenario (7 {/Symbol h}, T = 0.01MeV)" at graph 0.05,0.08
+plot 'workprec.txt' index 6 u 5:6 t 'stiff' w lp,\
+     'workprec.txt' index 7 u 5:6 t 'log' w lp,\
+     'workprec.txt' index 8 u 5:6 t 'nse' w lp,\
+     'workprec.txt' index 9 u 5:6 t 'hessenberg' w lp,\
+     'workprec.txt' index 10 u 5:6 t 'ln T' w lp,\
+     'workprec.txt' index 11 u 5:6 t 'krylov' w lp
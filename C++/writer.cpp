@@ -0,0 +1,127 @@
+// asynchronous output of text records (see writer.h)
+
+#include<chrono>
+#include "writer.h"
+
+static std::atomic<long> n_writer(0);// for id of async_writer
+
+async_writer::async_writer(std::ostream& o, int capacity, int batch)
+    : stalls(0), out(o), capacity(capacity), batch(batch), id(n_writer++),
+      n_ring(0), sleeping(false), done(false)
+{
+    thread = std::thread(&async_writer::run, this);
+}
+
+async_writer::~async_writer()
+// all producers must have finished write
+{
+    {
+        std::lock_guard<std::mutex> l(lock);
+        done = true;
+    }
+    wake.notify_one();
+    thread.join();
+}
+
+async_writer::ring *async_writer::find()
+// return ring of calling thread (made at first call)
+{
+    static thread_local std::vector<std::pair<long, ring*> > mine;
+    for(size_t i=0; i<mine.size(); i++)
+        if(mine[i].first == id) return mine[i].second;
+    std::lock_guard<std::mutex> l(lock);
+    rings.emplace_back(new ring(capacity));
+    n_ring = rings.size();
+    mine.push_back(std::make_pair(id, rings.back().get()));
+    return rings.back().get();
+}
+
+void async_writer::write(std::string& record)
+// push record to queue of calling thread;
+// record is swapped with empty string of queue (capacity of string
+// is reused without allocation)
+{
+    ring *r(find());
+    size_t t(r->tail.load(std::memory_order_relaxed));
+    if(t - r->head.load(std::memory_order_acquire) == size_t(capacity)) {
+        stalls++;
+        wake.notify_one();
+        while(t - r->head.load(std::memory_order_acquire) == size_t(capacity))
+            std::this_thread::yield();
+    }
+    std::string& s(r->slot[t % capacity]);
+    s.swap(record);
+    record.clear();
+    r->tail.store(t+1);// seq_cst, against check of sleeping below
+    if(sleeping) {
+        std::lock_guard<std::mutex> l(lock);
+        wake.notify_one();
+    }
+}
+
+void async_writer::flush()
+{
+    std::unique_lock<std::mutex> l(lock);
+    wake.notify_one();
+    idle.wait(l, [this]{
+        for(size_t i=0; i<rings.size(); i++)
+            if(rings[i]->head != rings[i]->tail) return false;
+        return sleeping.load();
+    });
+}
+
+bool async_writer::drain(std::string& buf)
+// move records in rings to buf, and write buf if it exceeds batch;
+// return false if there is no record
+{
+    std::vector<ring*>& r(view);
+    bool any(false);
+    if(r.size() != size_t(n_ring)) {
+        std::lock_guard<std::mutex> l(lock);
+        r.clear();
+        for(size_t i=0; i<rings.size(); i++) r.push_back(rings[i].get());
+    }
+    for(size_t i=0; i<r.size(); i++) {
+        size_t h(r[i]->head.load(std::memory_order_relaxed));
+        size_t t(r[i]->tail.load(std::memory_order_acquire));
+        for(; h != t; h++) {
+            any = true;
+            std::string& s(r[i]->slot[h % capacity]);
+            buf += s;
+            s.clear();
+            r[i]->head.store(h+1, std::memory_order_release);
+            if(buf.size() >= size_t(batch)) {
+                out.write(buf.data(), buf.size());
+                buf.clear();
+            }
+        }
+    }
+    return any;
+}
+
+void async_writer::run()
+// writer thread: write records in batches while producers are busy,
+// and flush stream when queues are empty
+{
+    std::string buf;
+    buf.reserve(batch);
+    for(;;) {
+        while(drain(buf));
+        if(buf.size()) {
+            out.write(buf.data(), buf.size());
+            buf.clear();
+        }
+        out.flush();
+        std::unique_lock<std::mutex> l(lock);
+        sleeping = true;// seq_cst, against store of tail in write
+        bool empty(true);
+        for(size_t i=0; i<rings.size(); i++)
+            if(rings[i]->head != rings[i]->tail) empty = false;
+        if(empty) {
+            idle.notify_all();
+            if(done) break;
+            wake.wait_for(l, std::chrono::milliseconds(100));
+        }
+        sleeping = false;
+    }
+}
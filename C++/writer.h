@@ -0,0 +1,77 @@
+// asynchronous output of text records
+//
+// solver threads format records (e.g. lines of a table) into strings
+// and push them to async_writer, and a dedicated writer thread writes
+// them to the stream in batches, so that solvers do not wait for file
+// system nor for each other on a lock of the stream, e.g.
+//   std::ofstream f("fig7.txt");
+//   async_writer w(f);
+//   std::string s;
+//   put(s, eta); s += ' '; put(s, X); s += '\n';
+//   w.write(s);// s is moved to queue (and cleared)
+// each producer thread has its own lock-free single-producer
+// single-consumer ring of capacity records, so that records of a
+// thread are written in the order of write, and a record (e.g. result
+// of a job) is never interleaved with others; if the ring is full,
+// write waits until writer thread catches up (backpressure), so that
+// memory is bounded by capacity records per thread
+// (async_writer::stalls counts such waits)
+
+#ifndef __writer_h__
+#define __writer_h__
+
+#include<atomic>
+#include<charconv>
+#include<condition_variable>
+#include<iostream>
+#include<memory>
+#include<mutex>
+#include<string>
+#include<thread>
+#include<vector>
+
+inline void put(std::string& s, double x, int precision=0)
+// append x to s by std::to_chars; shortest representation that is
+// read back to x exactly if precision=0, else as printf("%.*g")
+{
+    char b[32];
+    std::to_chars_result r(precision
+        ? std::to_chars(b, b+sizeof(b), x, std::chars_format::general, precision)
+        : std::to_chars(b, b+sizeof(b), x));
+    s.append(b, r.ptr - b);
+}
+
+inline void put(std::string& s, long x)
+{
+    char b[24];
+    s.append(b, std::to_chars(b, b+sizeof(b), x).ptr - b);
+}
+
+struct async_writer {
+    std::atomic<long> stalls;// number of waits for full ring
+    async_writer(std::ostream& o, int capacity=1024, int batch=1<<16);
+    ~async_writer();// write all records and stop writer thread
+    void write(std::string& record);
+    void flush();// wait until records written so far are in stream
+private:
+    struct ring {// single-producer single-consumer queue
+        std::vector<std::string> slot;
+        std::atomic<size_t> head, tail;// next to be read / written
+        ring(int capacity) : slot(capacity), head(0), tail(0) {;}
+    };
+    std::ostream& out;
+    int capacity, batch;
+    long id;// to find ring of calling thread
+    std::mutex lock;// for rings and sleep of writer
+    std::condition_variable wake, idle;
+    std::vector<std::unique_ptr<ring> > rings;
+    std::vector<ring*> view;// copy of rings for writer thread
+    std::atomic<int> n_ring;
+    std::atomic<bool> sleeping, done;
+    std::thread thread;
+    ring *find();
+    bool drain(std::string&);
+    void run();
+};
+
+#endif // __writer_h__
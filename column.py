@@ -0,0 +1,58 @@
+# reader of columnar binary file written by C++/column.cpp
+# (layout is described in C++/column.h)
+
+import numpy as np
+
+header = np.dtype([('magic','S4'), ('version','<i4'),
+                   ('n_col','<i4'), ('n_param','<i4')])
+info = np.dtype([('name','S32'), ('unit','S16'),
+                 ('codec','<i4'), ('pad','<i4')])
+param = np.dtype([('name','S32'), ('unit','S16'), ('value','<f8')])
+chunk = np.dtype([('magic','S4'), ('n_row','<i4')])
+
+def decode(b, n):
+    """ inverse of column_encode in column.cpp """
+    out,i = bytearray(),0
+    while i<len(b) and len(out)<8*n:
+        if b[i] < 128:
+            out += b[i+1:i+2+b[i]]; i += b[i]+2
+        else:
+            out += bytes([b[i+1]])*(b[i]-126); i += 2
+    u = np.frombuffer(bytes(out[:8*n]), np.uint8).reshape(8,n)
+    u = np.bitwise_or.reduce(u.T.astype('<u8')
+                             << np.arange(0,64,8,dtype='<u8'), axis=1)
+    return np.bitwise_xor.accumulate(u).view('<f8')
+
+def load(fname):
+    """ return (columns, params) where
+    columns = dict of name: numpy array (memory mapped if not compressed
+              and written in single chunk)
+    params = dict of name: value
+    """
+    m = np.memmap(fname, np.uint8, 'r')
+    h = np.frombuffer(m, header, 1)[0]
+    if h['magic'] != b'BBNC' or h['version'] != 1:
+        raise ValueError(fname + ': not a columnar file of version 1')
+    p = header.itemsize
+    c = np.frombuffer(m, info, h['n_col'], p); p += c.nbytes
+    q = np.frombuffer(m, param, h['n_param'], p); p += q.nbytes
+    names = [n.decode() for n in c['name']]
+    cols = [[] for _ in names]
+    while p + chunk.itemsize <= len(m):
+        k = np.frombuffer(m, chunk, 1, p)[0]
+        n = int(k['n_row'])
+        if k['magic'] != b'CHNK' or n <= 0: break
+        if p + chunk.itemsize + 8*len(names) > len(m): break
+        size = np.frombuffer(m, '<i8', len(names), p + chunk.itemsize)
+        end = p + chunk.itemsize + size.nbytes + int(np.sum((size+7)&~7))
+        if np.any(size < 0) or end > len(m): break# incomplete chunk
+        p += chunk.itemsize + size.nbytes
+        for j,s in enumerate(size):
+            if c['codec'][j] == 0:
+                cols[j].append(np.frombuffer(m, '<f8', n, p))
+            else:
+                cols[j].append(decode(bytes(m[p:p+s]), n))
+            p += (int(s)+7)&~7
+    cols = {n: x[0] if len(x)==1 else np.concatenate(x)
+            for n,x in zip(names,cols)}
+    return cols, {n.decode(): v for n,v in zip(q['name'],q['value'])}
@@ -0,0 +1,22 @@
+# round-trip test of column.py against files written by C++/fig5-6:
+# mass fractions in fig5-6.bbnc (raw and XOR_RLE columns) must equal
+# those in fig5-6.txt (printed in shortest form that is read back)
+# usage: python3 test_column.py  (builds C++/a.out by make fig5-6)
+
+import os, subprocess, tempfile
+import numpy as np
+from column import load
+
+cpp = os.path.join(os.path.dirname(os.path.abspath(__file__)), 'C++')
+subprocess.check_call(['make', '-s', 'fig5-6'], cwd=cpp)
+with tempfile.TemporaryDirectory() as d:
+    subprocess.check_call([os.path.join(cpp, 'a.out')], cwd=d)
+    subprocess.check_call([os.path.join(cpp, 'a.out'), '-b'], cwd=d)
+    X = np.loadtxt(os.path.join(d, 'fig5-6.txt'))
+    cols, params = load(os.path.join(d, 'fig5-6.bbnc'))
+names = list(cols)
+Y = np.array([cols[n] for n in names]).T
+assert names[0] == 'T' and Y.shape == X.shape, (names, Y.shape, X.shape)
+assert np.array_equal(X, Y), np.max(np.abs(X - Y))
+assert params['eta'] == 5e-10
+print('ok: %d rows x %d columns' % X.shape)
@@ -0,0 +1,18 @@
+# reference results of python implementation for C++/workprec
+# usage: python workprec.py > C++/workprec_py.txt
+#        cd C++; ./workprec -p workprec_py.txt
+# output: lines of N_nu eta X, where X = mass fractions at T=0.01MeV
+#         in the order of BBN::element in C++/nuclear.cpp
+
+import numpy as np
+from BBN import BBN,initialize
+
+index = ['neutron', 'proton', 'deutron', 'tritium',
+         'helium3', 'helium4', 'lithium7', 'beryllium7']
+
+eta = np.geomspace(1e-11, 1e-8, 7) # same as fig7 scenario of workprec
+for N_nu in [2,3,4]:
+    initialize(N_nu=N_nu)
+    for e in eta:
+        T,X = BBN(e, index, 2, rtol=1e-8, atol=1e-14)
+        print(N_nu, e, *X[:,-1])